@@ -33,6 +33,8 @@
 #include <string.h>
 #include <linux/limits.h>
 #include "interface.h"
+#include "output.h"
+#include "common.h"
 
 /* Prototypes used externaly */
 void amd_gpu_fini(Component_t *gpus);
@@ -47,36 +49,41 @@ enum amd_model {
 #include <rocm_smi/rocm_smi.h>
 
 /**
- * Retrieve the current value of the energy counter of a GPU
+ * Stage the current value of the energy counter of a GPU
  *
- * @param   dev[out]  Unit structure for the GPU
+ * @param   gpus[inout]  GPU structure
+ * @param   i[in]        Index of the GPU
  */
-static void _amd_device_fetch_energy(Unit_t *dev)
+static void _amd_device_fetch_energy(Component_t *gpus, const uint32_t i)
 {
-    uint64_t last_energy_raw = dev->energy_raw;
+    const Unit_t *dev = &gpus->siblings[i];
+    Counters_t *counters = &gpus->counters;
     float energy_resolution;
+    uint64_t gpu_timestamp;
 
     rsmi_status_t err = rsmi_dev_energy_count_get(dev->id,
-                                                  &dev->energy_raw,
+                                                  &counters->energy_raw_next[i],
                                                   &energy_resolution,
-                                                  &dev->timestamp);
+                                                  &gpu_timestamp);
     if (err != RSMI_STATUS_SUCCESS)
     {
         fprintf(stderr, "Failed to get energy counter for AMD device %u\n", dev->id);
         exit(EXIT_FAILURE);
     }
 
-    /* XXX: This type should be large enough to never overflow */
-    assert(dev->energy_raw >= last_energy_raw);
+    /* Use the monotonic clock, the timestamp of the GPU is not comparable
+     * with the other components */
+    counters->timestamp[i] = get_time_ns();
 
-    dev->energy_resolution = (double)energy_resolution;
+    /* The resolution is in microjoules */
+    counters->energy_scale[i] = energy_scale(energy_resolution);
 
     /* Don't compute energy consumption during first iteration */
-    if (last_energy_raw == 0)
-        return;
+    if (counters->energy_raw[i] == 0)
+        counters->energy_raw[i] = counters->energy_raw_next[i];
 
-    dev->energy_interval = dev->energy_resolution * (dev->energy_raw - last_energy_raw) / 1E6;
-    dev->energy_acc += dev->energy_interval;
+    /* XXX: This type should be large enough to never overflow */
+    assert(counters->energy_raw_next[i] >= counters->energy_raw[i]);
 }
 
 /**
@@ -95,91 +102,59 @@ static void _amd_device_fetch_activity(Unit_t *dev)
 }
 
 /**
- * Retrieve energy from a MI250 and split across GCDs
+ * Retrieve energy from a MI250 and split across GCDs, after the energy of
+ * the other GPUs is accounted
  *
- * @param   dev[out]  Unit structure for the GPU
+ * @param   gpus[inout]  GPU structure
+ * @param   i[in]        Index of the first GCD of the board
  */
-static void _amd_device_fetch_energy_mi250(Unit_t *dev)
+static void _amd_device_fetch_energy_mi250(Component_t *gpus, const uint32_t i)
 {
+    Unit_t *dev = &gpus->siblings[i];
+
     /* Already hanlded by peer GCD */
     if (dev->peer == NULL)
         return;
 
-    uint64_t last_energy_raw = dev->energy_raw;
-    float energy_resolution;
+    Counters_t *counters = &gpus->counters;
+    const uint32_t peer = dev->peer - gpus->siblings;
     const uint32_t gcd_idle_power = 40;   /* Eache GCD consumes 40W when idle */
-    uint64_t last_timestamp = dev->timestamp;
+    uint64_t last_timestamp = counters->timestamp[i];
 
     _amd_device_fetch_activity(dev);
     _amd_device_fetch_activity(dev->peer);
+    _amd_device_fetch_energy(gpus, i);
 
-    rsmi_status_t err = rsmi_dev_energy_count_get(dev->id,
-                                                  &dev->energy_raw,
-                                                  &energy_resolution,
-                                                  &dev->timestamp);
-    if (err != RSMI_STATUS_SUCCESS)
-    {
-        fprintf(stderr, "Failed to get energy counter for AMD device %u\n", dev->id);
-        exit(EXIT_FAILURE);
-    }
-
-    dev->energy_resolution = (double)energy_resolution;
-
-    /* XXX: This type should be large enough to never overflow */
-    assert(dev->energy_raw >= last_energy_raw);
-
-    /* Don't compute energy consumption during first iteration */
-    if (last_energy_raw == 0)
-        return;
-
-    const uint64_t energy = dev->energy_resolution * (dev->energy_raw - last_energy_raw) / 1E6;
+    const uint64_t delta = counters->energy_raw_next[i] - counters->energy_raw[i];
+    const uint64_t energy = (delta * counters->energy_scale[i]) >> SCALE_SHIFT;
+    counters->energy_raw[i] = counters->energy_raw_next[i];
 
     /* The model to slipt the energy across the GCDs is the following:
      * 1) Subtract the idle consumption (GCD overhead) from the measured one
      * 2) A formula computes the share of each GCD based on the activity
      * 3) The idle and active share is added the the final energy counter */
 
-    /* 1) GCD overhead (based on fixed Power consumption) and deduce it from the measured value */
-    const uint64_t elapsed_s = (dev->timestamp - last_timestamp) / 1E9;
-    const uint64_t energy_idle = gcd_idle_power * elapsed_s;
+    /* 1) GCD overhead (based on fixed Power consumption) and deduce it from the measured value,
+     *    all energies are in microjoules */
+    const uint64_t elapsed_us = (counters->timestamp[i] - last_timestamp) / 1000;
+    const uint64_t energy_idle = gcd_idle_power * elapsed_us;
     const uint64_t energy_min_idle = (energy > (2 * energy_idle)) ? (energy - (2 * energy_idle)) : 0;
 
     /* 2) Compute the share coefficient of the first GCD (0 <= value <= 1) */
     const double energy_ratio = (0.005 * dev->busy_percent) - (0.005 * dev->peer->busy_percent) + 0.5;
 
     /* 3) Assign overhead and energy share to each GCD */
-    dev->energy_interval = energy_idle + (energy_ratio * energy_min_idle);
-    dev->energy_acc += dev->energy_interval;
-    dev->peer->energy_interval = energy_idle + ((1.0 - energy_ratio) * energy_min_idle);
-    dev->peer->energy_acc += dev->peer->energy_interval;
+    unit_add_energy(counters, i, energy_idle + (energy_ratio * energy_min_idle));
+    unit_add_energy(counters, peer, energy_idle + ((1.0 - energy_ratio) * energy_min_idle));
+    counters->timestamp[peer] = counters->timestamp[i];
 }
 #endif /* AMD_GPU */
 
-/**
- * Write latest counter value in the destination file for a given GPU
- *
- * @param   dev[in]  Unit structure for the GPU
- */
-static void _amd_device_update_files(Unit_t *dev)
-{
-#ifdef AMD_GPU
-    /* With MI250 we need to split energy across GCDs  */
-    if (dev->model == MI250)
-        _amd_device_fetch_energy_mi250(dev);
-    else
-        _amd_device_fetch_energy(dev);
-
-    /* Updating the file */
-    fprintf(dev->energy_fd, "%lu Joules", dev->energy_acc);
-    rewind(dev->energy_fd); /* Flush buffer and prepare for overwriting next value */
-#endif /* AMD_GPU */
-}
-
 /**
  * Initialize this GPU module
  *
  * @param   gpus[out]       GPU structure to initialize all GPUs
- * @param   dest_dir[in]    Directory contaning the files with the energy counters
+ * @param   dest_dir[in]    Directory contaning the files with the energy counters (NULL if disabled)
  * @param   is_verbose[in]  Whether the verbose mode should be enabled
  * @param   is_disabled[in] Whether the module should be disabled
  */
@@ -207,7 +182,8 @@ void amd_gpu_init(Component_t *gpus, const char *dest_dir, const bool is_verbose
     }
 
     /* Get number of AMD GPU devices */
-    err = rsmi_num_monitor_devices(&gpus->n_siblings);
+    uint32_t count;
+    err = rsmi_num_monitor_devices(&count);
     if (err != RSMI_STATUS_SUCCESS)
     {
         fprintf(stderr, "Failed to get number of devices\n");
@@ -215,12 +191,15 @@ void amd_gpu_init(Component_t *gpus, const char *dest_dir, const bool is_verbose
         exit(EXIT_FAILURE);
     }
 
+    if (component_alloc(gpus, count) != 0)
+    {
+        rsmi_shut_down();
+        exit(EXIT_FAILURE);
+    }
+
     if (is_verbose)
         printf("%u AMD GPU devices found\n", gpus->n_siblings);
 
-    assert(gpus->n_siblings < N_SIBLINGS_MAX);
-
-
     for (uint32_t i = 0; i < gpus->n_siblings; ++i) {
         Unit_t *dev = &gpus->siblings[i];
         dev->id = i;
@@ -269,18 +248,12 @@ void amd_gpu_init(Component_t *gpus, const char *dest_dir, const bool is_verbose
         dev->bus_id = dev->bus_id >> 8;
 
         /* Fetching first raw value */
-        _amd_device_fetch_energy(dev);
-
-        char output_path[PATH_MAX];
+        _amd_device_fetch_energy(gpus, i);
 
         /* Opening normalized file (Joules) */
-        snprintf(output_path, sizeof(output_path), "%s/gpu_%2.2lx_energy", dest_dir, dev->bus_id);
-        dev->energy_fd = fopen(output_path, "w");
-        if (!dev->energy_fd)
-        {
-            fprintf(stderr, "Failed to open output file: %s\n", output_path);
+        snprintf(dev->name, sizeof(dev->name), "gpu_%2.2lx", dev->bus_id);
+        if (output_open(dev, dest_dir) != 0)
             exit(EXIT_FAILURE);
-        }
     }
 #endif /* AMD_GPU */
 }
@@ -296,7 +269,7 @@ void amd_gpu_fini(Component_t *gpus)
     for (uint32_t i = 0; i < gpus->n_siblings; ++i)
     {
         Unit_t *dev = &gpus->siblings[i];
-        fclose(dev->energy_fd);
+        output_close(dev);
     }
 
     rsmi_shut_down();
@@ -311,15 +284,34 @@ void amd_gpu_fini(Component_t *gpus)
 void amd_gpu_update(Component_t *gpus)
 {
     const bool is_verbose = gpus->is_verbose;
+    Counters_t *counters = &gpus->counters;
+
+#ifdef AMD_GPU
+    /* MI250 GCDs are accounted below */
+    for (uint32_t i = 0; i < gpus->n_siblings; ++i)
+        if (gpus->siblings[i].model == MI250)
+            counters->energy_raw_next[i] = counters->energy_raw[i];
+        else
+            _amd_device_fetch_energy(gpus, i);
+
+    counters_accumulate(counters, gpus->n_siblings, UINT64_MAX);
+
+    /* With MI250 we need to split energy across GCDs  */
+    for (uint32_t i = 0; i < gpus->n_siblings; ++i)
+        if (gpus->siblings[i].model == MI250)
+            _amd_device_fetch_energy_mi250(gpus, i);
+#endif /* AMD_GPU */
 
     for (uint32_t i = 0; i < gpus->n_siblings; ++i)
     {
         Unit_t *dev = &gpus->siblings[i];
-        _amd_device_update_files(dev);
+
+        /* Updating the file */
+        output_write(dev, counters->energy_acc[i]);
 
         if (is_verbose)
-            printf("AMD GPU %u (0x%2.2lx): %lu J (accumulator: %lu J, raw: %lu)\n",
-                   i, dev->bus_id, dev->energy_interval, dev->energy_acc, dev->energy_raw);
+            printf("AMD GPU %u (0x%2.2lx): %lu J (accumulator: %lu J, raw: %lu)\n", i, dev->bus_id,
+                   counters->energy_interval[i], counters->energy_acc[i], counters->energy_raw[i]);
     }
 }
 
@@ -0,0 +1,175 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* EnergyCounter: Fetch and expose energy counters.
+* buffer.h: Growable text buffer used to render the outputs.
+*
+* URL       https://github.com/HewlettPackard/EnergyCounter
+******************************************************************************/
+
+#ifndef BUFFER_H
+#define BUFFER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "output.h"
+
+typedef struct Buffer
+{
+    char   *data;
+    size_t  len;
+    size_t  size;
+} Buffer_t;
+
+/**
+ * Make sure a buffer can hold more characters. The memory is kept between
+ * two renderings, so the buffer only grows during the first ones.
+ *
+ * @param   buf[inout]  Buffer
+ * @param   len[in]     Amount of characters to append
+ */
+static inline void buffer_reserve(Buffer_t *buf, const size_t len)
+{
+    if (buf->len + len <= buf->size)
+        return;
+
+    size_t size = (buf->size > 0) ? buf->size : 4096;
+    while (size < buf->len + len)
+        size *= 2;
+
+    char *data = realloc(buf->data, size);
+    if (data == NULL)
+    {
+        fprintf(stderr, "Unable to allocate %zu bytes for an output buffer\n", size);
+        exit(EXIT_FAILURE);
+    }
+
+    buf->data = data;
+    buf->size = size;
+}
+
+static inline void buffer_reset(Buffer_t *buf)
+{
+    buf->len = 0;
+}
+
+static inline void buffer_free(Buffer_t *buf)
+{
+    free(buf->data);
+    memset(buf, 0, sizeof(Buffer_t));
+}
+
+static inline void buffer_append(Buffer_t *buf, const char *str, const size_t len)
+{
+    buffer_reserve(buf, len);
+    memcpy(&buf->data[buf->len], str, len);
+    buf->len += len;
+}
+
+static inline void buffer_append_str(Buffer_t *buf, const char *str)
+{
+    buffer_append(buf, str, strlen(str));
+}
+
+static inline void buffer_append_u64(Buffer_t *buf, const uint64_t value)
+{
+    buffer_reserve(buf, OUTPUT_U64_LEN_MAX);
+    buf->len += output_format_u64(&buf->data[buf->len], value);
+}
+
+/**
+ * Append microjoules as Joules with 6 decimals
+ */
+static inline void buffer_append_uj(Buffer_t *buf, const uint64_t value)
+{
+    char decimals[7] = "000000";
+    uint64_t fraction = value % 1000000;
+
+    for (int i = 5; i >= 0 && fraction > 0; i--, fraction /= 10)
+        decimals[i] = '0' + (fraction % 10);
+
+    buffer_append_u64(buf, value / 1000000);
+    buffer_append(buf, ".", 1);
+    buffer_append(buf, decimals, 6);
+}
+
+/**
+ * Append a string escaped for a JSON string value
+ */
+static inline void buffer_append_json(Buffer_t *buf, const char *str)
+{
+    for (; *str != '\0'; str++)
+    {
+        const unsigned char c = *str;
+
+        if (c == '"' || c == '\\')
+        {
+            buffer_append(buf, "\\", 1);
+            buffer_append(buf, str, 1);
+        }
+        else if (c < 0x20)
+        {
+            const char escaped[6] = {'\\', 'u', '0', '0', "0123456789abcdef"[c >> 4],
+                                     "0123456789abcdef"[c & 0xf]};
+            buffer_append(buf, escaped, sizeof(escaped));
+        }
+        else
+            buffer_append(buf, str, 1);
+    }
+}
+
+/**
+ * Append a string escaped for a Prometheus label value
+ */
+static inline void buffer_append_label(Buffer_t *buf, const char *str)
+{
+    for (; *str != '\0'; str++)
+    {
+        if (*str == '"' || *str == '\\')
+        {
+            buffer_append(buf, "\\", 1);
+            buffer_append(buf, str, 1);
+        }
+        else if (*str == '\n')
+            buffer_append(buf, "\\n", 2);
+        else
+            buffer_append(buf, str, 1);
+    }
+}
+
+static inline void buffer_append_hex(Buffer_t *buf, uint64_t value)
+{
+    char digits[16];
+    uint32_t n = 0;
+
+    do
+    {
+        digits[15 - n++] = "0123456789abcdef"[value & 0xf];
+        value >>= 4;
+    } while (value > 0);
+
+    buffer_append(buf, "0x", 2);
+    buffer_append(buf, &digits[16 - n], n);
+}
+
+#endif /* BUFFER_H */
@@ -0,0 +1,323 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* EnergyCounter: Fetch and expose energy counters.
+* checkpoint.c: Accumulators persisted in a memory-mapped file, so counters
+*               stay monotonic when the daemon restarts.
+*
+* URL       https://github.com/HewlettPackard/EnergyCounter
+******************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "interface.h"
+
+#define CHECKPOINT_MAGIC    0x504b4345  /* "ECKP" */
+#define CHECKPOINT_VERSION  3   /* Accumulators in microjoules since version 2,
+                                   energy scale of the raw values since version 3 */
+#define CHECKPOINT_BOOT_ID  "/proc/sys/kernel/random/boot_id"
+
+/* Accumulator and raw value written together, see CheckpointEntry_t */
+typedef struct CheckpointSlot
+{
+    uint64_t  energy_acc_uj;
+    uint64_t  energy_raw;
+} CheckpointSlot_t;
+
+/* A unit is identified by its type, vendor, bus id, id, name and serial
+ * number. Updates go to the inactive slot which is then made active, so a
+ * crash in the middle of an update leaves the previous values. */
+typedef struct CheckpointEntry
+{
+    uint32_t          type;
+    uint32_t          vendor;
+    uint32_t          id;
+    uint32_t          active;       /* Index of the valid slot             */
+    uint64_t          bus_id;
+    char              name[32];
+    char              serial[64];
+    CheckpointSlot_t  slots[2];
+    uint64_t          energy_scale; /* Of the raw values, 0 before version 3 */
+} CheckpointEntry_t;
+
+/* Size of the entries before version 3 */
+#define CHECKPOINT_ENTRY_V2_SIZE  offsetof(CheckpointEntry_t, energy_scale)
+
+typedef struct Checkpoint
+{
+    uint32_t          magic;
+    uint32_t          version;
+    uint32_t          n_entries;
+    uint32_t          entry_size;   /* sizeof(CheckpointEntry_t)           */
+    char              boot_id[48];  /* Boot of the last update             */
+    CheckpointEntry_t entries[];
+} Checkpoint_t;
+
+static Checkpoint_t *_checkpoint = NULL;
+static size_t        _checkpoint_size = 0;
+
+/**
+ * Read the identifier of the current boot
+ *
+ * @param   boot_id[out]  Identifier, empty if unknown
+ * @param   len[in]       Size of the identifier buffer
+ */
+static void _checkpoint_boot_id(char *boot_id, const size_t len)
+{
+    memset(boot_id, 0, len);
+
+    FILE *fp = fopen(CHECKPOINT_BOOT_ID, "r");
+    if (fp == NULL)
+        return;
+
+    if (fgets(boot_id, len, fp) != NULL)
+        boot_id[strcspn(boot_id, "\n")] = '\0';
+    fclose(fp);
+}
+
+/**
+ * Fill the identity of the entry of a unit
+ */
+static void _checkpoint_set_key(CheckpointEntry_t *entry, const Component_t *component,
+                                const Unit_t *unit)
+{
+    memset(entry, 0, sizeof(CheckpointEntry_t));
+    entry->type = component->type;
+    entry->vendor = component->vendor;
+    entry->id = unit->id;
+    entry->bus_id = unit->bus_id;
+    snprintf(entry->name, sizeof(entry->name), "%s", unit->name);
+    snprintf(entry->serial, sizeof(entry->serial), "%s", unit->serial);
+}
+
+static bool _checkpoint_is_same_key(const CheckpointEntry_t *a, const CheckpointEntry_t *b)
+{
+    return a->type == b->type && a->vendor == b->vendor && a->id == b->id &&
+           a->bus_id == b->bus_id &&
+           strncmp(a->name, b->name, sizeof(a->name)) == 0 &&
+           strncmp(a->serial, b->serial, sizeof(a->serial)) == 0;
+}
+
+/**
+ * Load the previous checkpoint in memory
+ *
+ * @param   path[in]   Path of the checkpoint
+ * @return  Copy of the checkpoint to free, NULL if there is no valid one
+ */
+static Checkpoint_t *_checkpoint_load(const char *path)
+{
+    struct stat st;
+    Checkpoint_t *previous = NULL;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(Checkpoint_t))
+    {
+        previous = malloc(st.st_size);
+        if (previous != NULL &&
+            (pread(fd, previous, st.st_size, 0) != st.st_size ||
+             previous->magic != CHECKPOINT_MAGIC || previous->version < 1 ||
+             previous->version > CHECKPOINT_VERSION ||
+             previous->entry_size != ((previous->version < 3) ? CHECKPOINT_ENTRY_V2_SIZE :
+                                      sizeof(CheckpointEntry_t)) ||
+             sizeof(Checkpoint_t) + (size_t)previous->n_entries * previous->entry_size >
+             (size_t)st.st_size))
+        {
+            fprintf(stderr, "Ignoring invalid checkpoint %s\n", path);
+            free(previous);
+            previous = NULL;
+        }
+    }
+
+    close(fd);
+
+    return previous;
+}
+
+/**
+ * Map the checkpoint of all units and resume their accumulators from the
+ * previous one. During the same boot, a unit also resumes from its last raw
+ * value if the hardware counter did not go backwards, so the energy
+ * consumed while the daemon was stopped is accounted for.
+ *
+ * @param   path[in]         Path of the checkpoint
+ * @param   components[inout] Array of all components
+ * @param   n_components[in] Amount of components
+ * @param   is_verbose[in]   Whether the verbose mode should be enabled
+ * @return  0 on success, a negative error code otherwise
+ */
+int checkpoint_init(const char *path, Component_t *components, const uint32_t n_components,
+                    const bool is_verbose)
+{
+    uint32_t n_units = 0;
+    char boot_id[sizeof(_checkpoint->boot_id)];
+
+    for (uint32_t i = 0; i < n_components; i++)
+        n_units += components[i].n_siblings;
+
+    _checkpoint_boot_id(boot_id, sizeof(boot_id));
+    Checkpoint_t *previous = _checkpoint_load(path);
+    const bool is_same_boot = (previous != NULL && boot_id[0] != '\0' &&
+                               strncmp(previous->boot_id, boot_id, sizeof(boot_id)) == 0);
+
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        free(previous);
+        return -errno;
+    }
+
+    _checkpoint_size = sizeof(Checkpoint_t) + n_units * sizeof(CheckpointEntry_t);
+    int ret = (ftruncate(fd, _checkpoint_size) == 0) ? 0 : -errno;
+    if (ret == 0)
+    {
+        _checkpoint = mmap(NULL, _checkpoint_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (_checkpoint == MAP_FAILED)
+        {
+            _checkpoint = NULL;
+            ret = -errno;
+        }
+    }
+    close(fd);
+
+    if (ret != 0)
+    {
+        free(previous);
+        return ret;
+    }
+
+    memset(_checkpoint, 0, _checkpoint_size);
+    _checkpoint->magic = CHECKPOINT_MAGIC;
+    _checkpoint->version = CHECKPOINT_VERSION;
+    _checkpoint->n_entries = n_units;
+    _checkpoint->entry_size = sizeof(CheckpointEntry_t);
+    memcpy(_checkpoint->boot_id, boot_id, sizeof(boot_id));
+
+    uint32_t k = 0;
+    for (uint32_t i = 0; i < n_components; i++)
+    {
+        Component_t *component = &components[i];
+
+        for (uint32_t j = 0; j < component->n_siblings; j++, k++)
+        {
+            const Unit_t *unit = &component->siblings[j];
+            Counters_t *counters = &component->counters;
+            CheckpointEntry_t *entry = &_checkpoint->entries[k];
+
+            _checkpoint_set_key(entry, component, unit);
+
+            for (uint32_t l = 0; previous != NULL && l < previous->n_entries; l++)
+            {
+                /* Older entries are shorter */
+                const CheckpointEntry_t *old = (const CheckpointEntry_t *)
+                    ((const uint8_t *)previous->entries + l * previous->entry_size);
+                const CheckpointSlot_t *slot = &old->slots[old->active & 1];
+
+                if (!_checkpoint_is_same_key(entry, old))
+                    continue;
+
+                /* Version 1 stored Joules */
+                counters->energy_acc_uj[j] = slot->energy_acc_uj * ((previous->version == 1) ? UJ_PER_J : 1);
+                counters->energy_acc[j] = counters->energy_acc_uj[j] / UJ_PER_J;
+
+                /* Raw values of another backend (e.g. powercap instead of
+                 * the MSRs) are not comparable */
+                const uint64_t energy_scale = (previous->version < 3) ? 0 : old->energy_scale;
+                if (is_same_boot && slot->energy_raw != 0 && counters->energy_raw[j] >= slot->energy_raw &&
+                    energy_scale == counters->energy_scale[j])
+                    counters->energy_raw[j] = slot->energy_raw;
+
+                if (is_verbose)
+                    printf("Resuming %s from checkpoint: %lu J\n", unit->name, counters->energy_acc[j]);
+                break;
+            }
+
+            entry->energy_scale = counters->energy_scale[j];
+            entry->slots[0].energy_acc_uj = counters->energy_acc_uj[j];
+            entry->slots[0].energy_raw = counters->energy_raw[j];
+        }
+    }
+
+    free(previous);
+
+    return 0;
+}
+
+/**
+ * Unmap the checkpoint, the file is kept for the next start
+ */
+void checkpoint_fini(void)
+{
+    if (_checkpoint == NULL)
+        return;
+
+    munmap(_checkpoint, _checkpoint_size);
+    _checkpoint = NULL;
+}
+
+/**
+ * Save the units of the components collected during the last round
+ *
+ * @param   components[in]   Array of all components
+ * @param   n_components[in] Amount of components
+ * @param   tick[in]         Scheduler round to save
+ */
+void checkpoint_record(const Component_t *components, const uint32_t n_components,
+                       const uint64_t tick)
+{
+    if (_checkpoint == NULL)
+        return;
+
+    uint32_t k = 0;
+    for (uint32_t i = 0; i < n_components; i++)
+    {
+        const Component_t *component = &components[i];
+
+        if (component->tick != tick)
+        {
+            k += component->n_siblings;
+            continue;
+        }
+
+        for (uint32_t j = 0; j < component->n_siblings; j++, k++)
+        {
+            CheckpointEntry_t *entry = &_checkpoint->entries[k];
+            const uint32_t inactive = (entry->active & 1) ^ 1;
+
+            entry->slots[inactive].energy_acc_uj = component->counters.energy_acc_uj[j];
+            entry->slots[inactive].energy_raw = component->counters.energy_raw[j];
+
+            /* The slot is complete before becoming the active one */
+            __atomic_store_n(&entry->active, inactive, __ATOMIC_RELEASE);
+        }
+    }
+}
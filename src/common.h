@@ -31,16 +31,46 @@
 #include <cpuid.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <time.h>
 
 #define MIN(a,b) (((a)<(b))?(a):(b))
 #define MAX(a,b) (((a)>(b))?(a):(b))
 
-#define MSR_PATH_MAX 20
+#define NS_PER_MS 1000000ULL
+#define NS_PER_S  1000000000ULL
+
 #define MSR_ENERGY_UNIT_MASK     0x1f
 #define MSR_AMD_POWER_UNIT       0xc0010299
 #define MSR_INTEL_POWER_UNIT     0x606
 
+/**
+ * Return the current time of the monotonic clock in nanoseconds
+ */
+static inline uint64_t get_time_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * NS_PER_S + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Return the average power in milliwatts of an energy spent over a duration.
+ * The product is computed in 128 bits, it overflows 64 bits beyond 18 MJ.
+ *
+ * @param   energy_uj[in]    Energy in microjoules
+ * @param   elapsed_ns[in]   Duration in nanoseconds, not 0
+ */
+static inline uint64_t get_power_mw(const uint64_t energy_uj, const uint64_t elapsed_ns)
+{
+    const unsigned __int128 power = (unsigned __int128)energy_uj * NS_PER_MS / elapsed_ns;
+
+    return (power > UINT64_MAX) ? UINT64_MAX : (uint64_t)power;
+}
+
 /**
  * Execute CPUID instruction and read registers to fetch the CPU vendor type
  */
@@ -63,34 +93,21 @@ static inline int get_vendor(void)
 }
 
 /**
- * Read and return the content of a model specific register (MSR) for CPU
- *
- * @param   smt_id[in]  Id of the hardware thread (SMT id)
- * @param   type[in]    MSR type
+ * Execute CPUID instruction and read registers to fetch the CPU model,
+ * extended model included
  */
-static inline uint64_t read_msr(const uint32_t smt_id, const uint32_t type)
+static inline uint32_t get_model(void)
 {
-    char file_path[MSR_PATH_MAX];
-    uint64_t data;
-
-    snprintf(file_path, MSR_PATH_MAX, "/dev/cpu/%u/msr", smt_id);
-
-    int fd = open(file_path, O_RDONLY);
-    if (fd < 0)
-    {
-        fprintf(stderr, "Unable to open MSR file %s: %s\n", file_path, strerror(errno));
-        exit(EXIT_FAILURE);
-    }
+    uint32_t eax, ebx, ecx, edx;
 
-    if (pread(fd, &data, sizeof(data), type) != sizeof(data))
-    {
-        fprintf(stderr, "Unable to fetch MSR %x in %s\n", type, file_path);
-        exit(EXIT_FAILURE);
-    }
+    __cpuid(1, eax, ebx, ecx, edx);
 
-    close(fd);
+    const uint32_t family = (eax >> 8) & 0xf;
+    uint32_t model = (eax >> 4) & 0xf;
+    if (family == 6 || family == 15)
+        model |= (eax >> 12) & 0xf0;
 
-    return data;
+    return model;
 }
 
 #endif /* COMMON_H */
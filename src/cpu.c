@@ -20,7 +20,8 @@
 * OTHER DEALINGS IN THE SOFTWARE.
 ******************************************************************************
 * EnergyCounter: Fetch and expose energy counters.
-* cpu.c: Module for AMD and INTEL CPUs.
+* cpu.c: Module for AMD and INTEL CPUs: package energy, and the core (PP0),
+*        uncore (PP1) and platform (PSYS) energy where available.
 *
 * URL       https://github.com/HewlettPackard/EnergyCounter
 ******************************************************************************/
@@ -33,94 +34,52 @@
 #include <string.h>
 #include <errno.h>
 #include <linux/limits.h>
-#include <math.h>
 #include "interface.h"
+#include "output.h"
 #include "common.h"
-
-#define MSR_AMD_PACKAGE_ENERGY   0xc001029b
-#define MSR_INTEL_PACKAGE_ENERGY 0x611
-
-static uint32_t _cpu_package_to_core[N_SIBLINGS_MAX] = {0};
+#include "rapl.h"
 
 /* Prototypes used externaly */
 void cpu_fini(Component_t *cpus);
 void cpu_update(Component_t *cpus);
 
+static int *_cpu_unit_domains = NULL;   /* RAPL domain of each unit */
+
 #ifdef CPU_PACKAGE
+/* Domains exposed by this module, the units of a domain follow each other */
+static const int _cpu_domains[] = { RAPL_PKG, RAPL_PP0, RAPL_PP1, RAPL_PSYS };
+
 /**
- * Retrieve the current value of the package energy counter
+ * Retrieve the current value of the energy counter of a unit
  *
- * @param   package[out]  Unit structure for the package
- * @param   vendor[in]    Vendor type
+ * @param   cpus[inout]  CPU structure
+ * @param   i[in]        Index of the unit
+ * @return  0 on success, a negative error code otherwise
  */
-static void _cpu_package_fetch_energy(Unit_t *package, const int vendor)
+static int _cpu_package_fetch_energy(Component_t *cpus, const uint32_t i)
 {
-    uint32_t core_id = _cpu_package_to_core[package->id];
+    const RaplSample_t *sample = rapl_sample(cpus->siblings[i].id, cpus->tick);
+    const int domain = _cpu_unit_domains[i];
 
-    switch (vendor)
+    if (sample->status[domain] != 0)
     {
-        case INTEL:
-            package->energy_raw = read_msr(core_id, MSR_INTEL_PACKAGE_ENERGY);
-            break;
-        case AMD:
-            package->energy_raw = read_msr(core_id, MSR_AMD_PACKAGE_ENERGY);
-            break;
-        default:
-            fprintf(stderr, "Unknown or supported CPU type: %d\n", vendor);
-            exit(EXIT_FAILURE);
+        fprintf(stderr, "Unable to fetch %s energy of CPU package %u: %s\n", rapl_domain_str[domain],
+                cpus->siblings[i].id, strerror(-sample->status[domain]));
+        return sample->status[domain];
     }
 
-    /* Return if resolution was already fetched */
-    if (package->energy_resolution > 0)
-        return;
-
-    uint64_t msr_unit;
-    switch (vendor)
-    {
-        case INTEL:
-            msr_unit = read_msr(core_id, MSR_INTEL_POWER_UNIT);
-            break;
-        case AMD:
-            msr_unit = read_msr(core_id, MSR_AMD_POWER_UNIT);
-            break;
-        default:
-            return;
-    }
+    cpus->counters.energy_raw_next[i] = sample->energy_raw[domain];
+    cpus->counters.timestamp[i] = sample->timestamp;
 
-    package->energy_resolution = pow(0.5, (double)((msr_unit >> 8) & MSR_ENERGY_UNIT_MASK));
+    return 0;
 }
 #endif /* CPU_PACKAGE */
 
-/**
- * Write latest counter value in the destination file for a given CPU package
- *
- * @param   package[in]  Unit structure for the package
- * @param   vendor[in]   CPU vendor
- */
-static void _cpu_package_update_files(Unit_t *package, const int vendor)
-{
-#ifdef CPU_PACKAGE
-    uint64_t last_energy_raw = package->energy_raw;
-    _cpu_package_fetch_energy(package, vendor);
-
-    if (package->energy_raw >= last_energy_raw)
-        package->energy_interval = package->energy_resolution * (package->energy_raw - last_energy_raw);
-    else /* Counter may wraparound  */
-        package->energy_interval = package->energy_resolution * (((1LU << 32) - last_energy_raw) + package->energy_raw);
-
-    package->energy_acc += package->energy_interval;
-
-    /* Updating the file */
-    fprintf(package->energy_fd, "%lu Joules", package->energy_acc);
-    rewind(package->energy_fd); /* Flush buffer and prepare for overwriting next value */
-#endif /* CPU_PACKAGE */
-}
-
 /**
  * Initialize this CPU module
  *
  * @param   cpus[out]       CPU structure to initialize all CPU packages
- * @param   dest_dir[in]    Directory contaning the files with the energy counters
+ * @param   dest_dir[in]    Directory contaning the files with the energy counters (NULL if disabled)
  * @param   is_verbose[in]  Whether the verbose mode should be enabled
  * @param   is_disabled[in] Whether the module should be disabled
  */
@@ -140,46 +99,62 @@ void cpu_init(Component_t *cpus, const char *dest_dir, const bool is_verbose, co
     if (is_disabled)
         return;
 
-    /* Get package mapping and amount of packages */
-    for(uint32_t i = 0;; i++)
+    if (rapl_init(cpus->vendor) != 0)
+        exit(EXIT_FAILURE);
+
+    /* Every domain is optional, e.g. virtual machines may only count PSYS */
+    bool is_enabled[RAPL_DOMAINS_MAX] = { false };
+    uint32_t n_units = 0;
+    for (uint32_t d = 0; d < sizeof(_cpu_domains) / sizeof(_cpu_domains[0]); d++)
     {
-        char file_path[PATH_MAX];
-        uint32_t package_id;
-        snprintf(file_path, PATH_MAX, "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", i);
-
-        FILE *file = fopen(file_path,"r");
-        if (file == NULL)
-            break;
-
-        fscanf(file,"%u", &package_id);
-        fclose(file);
-        cpus->n_siblings = MAX(cpus->n_siblings, package_id + 1);
-        _cpu_package_to_core[package_id] = i;
+        const int domain = _cpu_domains[d];
+
+        is_enabled[domain] = (rapl_enable(domain) == 0);
+        for (uint32_t j = 0; is_enabled[domain] && j < rapl_n_packages(); j++)
+            n_units += rapl_is_available(j, domain);
+    }
+
+    if (n_units == 0)
+    {
+        fprintf(stderr, "CPU energy counters are not available\n");
+        rapl_fini();
+        return;
     }
 
+    _cpu_unit_domains = calloc(n_units, sizeof(int));
+    if (_cpu_unit_domains == NULL || component_alloc(cpus, n_units) != 0)
+        exit(EXIT_FAILURE);
+
     if (is_verbose)
-        printf("%s CPU(s) found with %u package(s)\n", vendor_str[cpus->vendor], cpus->n_siblings);
+        printf("%s CPU(s) found with %u package(s) and %u energy counter(s)\n", vendor_str[cpus->vendor],
+               rapl_n_packages(), cpus->n_siblings);
 
-    assert(cpus->n_siblings < N_SIBLINGS_MAX);
+    uint32_t i = 0;
+    for (uint32_t d = 0; d < sizeof(_cpu_domains) / sizeof(_cpu_domains[0]); d++)
+        for (uint32_t j = 0; j < rapl_n_packages(); j++)
+        {
+            const int domain = _cpu_domains[d];
+            Unit_t *package = &cpus->siblings[i];
 
-    for (uint32_t i = 0; i < cpus->n_siblings; i++) {
-        Unit_t *package = &cpus->siblings[i];
-        package->id = i;
+            if (!is_enabled[domain] || !rapl_is_available(j, domain))
+                continue;
 
-        /* Fetching first raw value */
-        _cpu_package_fetch_energy(package, cpus->vendor);
+            package->id = j;
+            _cpu_unit_domains[i] = domain;
 
-        char output_path[PATH_MAX];
+            cpus->counters.energy_scale[i] = energy_scale(rapl_energy_resolution(j, domain) * UJ_PER_J);
 
-        /* Opening normalized file (Joules) */
-        snprintf(output_path, sizeof(output_path), "%s/cpu_package_%d_energy", dest_dir, package->id);
-        package->energy_fd = fopen(output_path, "w");
-        if (!package->energy_fd)
-        {
-            fprintf(stderr, "Failed to open output file: %s\n", output_path);
-            exit(EXIT_FAILURE);
+            /* Fetching first raw value */
+            if (_cpu_package_fetch_energy(cpus, i) != 0)
+                exit(EXIT_FAILURE);
+            cpus->counters.energy_raw[i] = cpus->counters.energy_raw_next[i];
+
+            /* Opening normalized file (Joules) */
+            snprintf(package->name, sizeof(package->name), "cpu_%s_%u", rapl_domain_str[domain], package->id);
+            if (output_open(package, dest_dir) != 0)
+                exit(EXIT_FAILURE);
+            i++;
         }
-    }
 #endif /* CPU_PACKAGE */
 }
 
@@ -194,8 +169,14 @@ void cpu_fini(Component_t *cpus)
     for (uint32_t i = 0; i < cpus->n_siblings; ++i)
     {
         Unit_t *package = &cpus->siblings[i];
-        fclose(package->energy_fd);
+        output_close(package);
     }
+
+    if (cpus->n_siblings > 0)
+        rapl_fini();
+
+    free(_cpu_unit_domains);
+    _cpu_unit_domains = NULL;
 #endif /* CPU_PACKAGE */
 }
 
@@ -207,14 +188,27 @@ void cpu_fini(Component_t *cpus)
 void cpu_update(Component_t *cpus)
 {
     const bool is_verbose = cpus->is_verbose;
+    Counters_t *counters = &cpus->counters;
+
+#ifdef CPU_PACKAGE
+    /* A counter which cannot be read keeps its last value, the energy
+     * will be accounted during the next successful read */
+    for (uint32_t i = 0; i < cpus->n_siblings; ++i)
+        if (_cpu_package_fetch_energy(cpus, i) != 0)
+            counters->energy_raw_next[i] = counters->energy_raw[i];
+
+    /* The sampler unrolls the wraparound of the RAPL counters */
+    counters_accumulate(counters, cpus->n_siblings, UINT64_MAX);
+#endif /* CPU_PACKAGE */
 
     for (uint32_t i = 0; i < cpus->n_siblings; ++i)
     {
-        Unit_t *package = &cpus->siblings[i];
-        _cpu_package_update_files(package, cpus->vendor);
+        /* Updating the file */
+        output_write(&cpus->siblings[i], counters->energy_acc[i]);
 
         if (is_verbose)
-            printf("%s CPU package %u: %lu J (accumulator: %lu J, raw: %lu)\n",
-                   vendor_str[cpus->vendor], i, package->energy_interval, package->energy_acc, package->energy_raw);
+            printf("%s CPU %s %u: %lu J (accumulator: %lu J, raw: %lu)\n", vendor_str[cpus->vendor],
+                   rapl_domain_str[_cpu_unit_domains[i]], cpus->siblings[i].id, counters->energy_interval[i],
+                   counters->energy_acc[i], counters->energy_raw[i]);
     }
 }
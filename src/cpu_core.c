@@ -0,0 +1,454 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* EnergyCounter: Fetch and expose energy counters.
+* cpu_core.c: Module for the energy of every AMD CPU core, rolled up per CCX,
+*             CCD and package. The cores are read in one pass shared by a few
+*             reader threads.
+*
+* URL       https://github.com/HewlettPackard/EnergyCounter
+******************************************************************************/
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/limits.h>
+#include "interface.h"
+#include "output.h"
+#include "common.h"
+#include "msr.h"
+#include "topology.h"
+
+#define MSR_AMD_CORE_ENERGY  0xc001029a
+#define CORE_READERS_MAX     8      /* Threads reading the cores, caller included */
+
+enum core_level {
+    CORE_CCX,
+    CORE_CCD,
+    CORE_PACKAGE,
+    CORE_LEVELS_MAX
+};
+
+/* Cores read by a thread, the first reader is the caller of cpu_core_update() */
+typedef struct CoreReader
+{
+    pthread_t     thread;
+    Component_t  *cores;
+    uint32_t      first;
+    uint32_t      end;
+} CoreReader_t;
+
+/* Prototypes used externaly */
+void cpu_core_fini(Component_t *cores);
+void cpu_core_update(Component_t *cores);
+
+#ifdef CPU_PACKAGE
+static const char * const core_level_str[] =
+{
+    [CORE_CCX]     = "cpu_ccx",
+    [CORE_CCD]     = "cpu_ccd",
+    [CORE_PACKAGE] = "cpu_core_package",
+};
+
+static uint32_t           _core_n_cores = 0;          /* Units of the cores, rollups follow */
+static uint32_t         (*_core_parents)[CORE_LEVELS_MAX] = NULL; /* Rollup units of a core */
+static CoreReader_t       _core_readers[CORE_READERS_MAX];
+static uint32_t           _core_n_readers = 0;
+static pthread_barrier_t  _core_start;
+static pthread_barrier_t  _core_done;
+static bool               _core_is_stopping = false;
+
+/**
+ * Read a value from the sysfs directory of a CPU
+ *
+ * @param   cpu[in]     Id of the hardware thread
+ * @param   file[in]    Path relative to the directory of the CPU
+ * @param   value[out]  First integer of the file
+ * @return  0 on success, a negative error code otherwise
+ */
+static int _cpu_core_read_sysfs(const uint32_t cpu, const char *file, uint32_t *value)
+{
+    char file_path[PATH_MAX];
+    snprintf(file_path, PATH_MAX, "/sys/devices/system/cpu/cpu%u/%s", cpu, file);
+
+    FILE *fp = fopen(file_path, "r");
+    if (fp == NULL)
+        return -errno;
+
+    const int ret = (fscanf(fp, "%u", value) == 1) ? 0 : -EINVAL;
+    fclose(fp);
+
+    return ret;
+}
+
+/**
+ * Find the index of a rollup, or add it
+ *
+ * @param   keys[inout]   Keys of the rollups of a level
+ * @param   n_keys[inout] Amount of rollups of the level
+ * @param   key[in]       Package and id of the rollup
+ * @return  Index of the rollup in its level
+ */
+static uint32_t _cpu_core_find_rollup(uint64_t *keys, uint32_t *n_keys, const uint64_t key)
+{
+    for (uint32_t i = 0; i < *n_keys; i++)
+        if (keys[i] == key)
+            return i;
+
+    keys[*n_keys] = key;
+
+    return (*n_keys)++;
+}
+
+/**
+ * Retrieve the current value of the energy counters of a range of cores
+ *
+ * @param   cores[inout]  Core structure
+ * @param   first[in]     Index of the first core
+ * @param   end[in]       Index after the last core
+ * @return  0 on success, the error of the last core which could not be read otherwise
+ */
+static int _cpu_core_fetch_energy(Component_t *cores, const uint32_t first, const uint32_t end)
+{
+    Counters_t *counters = &cores->counters;
+    int status = 0;
+
+    for (uint32_t i = first; i < end; i++)
+    {
+        /* The energy of an offline core is accounted once it is back online */
+        if (!topology_is_online(cores->siblings[i].id))
+        {
+            counters->energy_raw_next[i] = counters->energy_raw[i];
+            continue;
+        }
+
+        uint64_t energy_raw;
+        const int ret = msr_read(cores->siblings[i].id, MSR_AMD_CORE_ENERGY, &energy_raw);
+
+        /* A counter which cannot be read keeps its last value, the energy
+         * will be accounted during the next successful read */
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to fetch energy of CPU core %u: %s\n", cores->siblings[i].id,
+                    strerror(-ret));
+            counters->energy_raw_next[i] = counters->energy_raw[i];
+            status = ret;
+            continue;
+        }
+
+        counters->energy_raw_next[i] = energy_raw;
+        counters->timestamp[i] = get_time_ns();
+    }
+
+    return status;
+}
+
+/**
+ * Read the cores of a reader on each collection, until the module stops
+ *
+ * @param   arg[in]   Reader structure
+ */
+static void *_cpu_core_reader(void *arg)
+{
+    const CoreReader_t *reader = (const CoreReader_t *)arg;
+
+    while (true)
+    {
+        pthread_barrier_wait(&_core_start);
+        if (_core_is_stopping)
+            break;
+
+        _cpu_core_fetch_energy(reader->cores, reader->first, reader->end);
+        pthread_barrier_wait(&_core_done);
+    }
+
+    return NULL;
+}
+
+/**
+ * Split the cores in contiguous ranges and start one thread per range but
+ * the first one, read by the caller
+ *
+ * @param   cores[in]      Core structure
+ * @param   n_readers[in]  Amount of readers
+ * @return  0 on success, a negative error code otherwise
+ */
+static int _cpu_core_start_readers(Component_t *cores, const uint32_t n_readers)
+{
+    for (uint32_t i = 0; i < n_readers; i++)
+    {
+        _core_readers[i].cores = cores;
+        _core_readers[i].first = i * _core_n_cores / n_readers;
+        _core_readers[i].end = (i + 1) * _core_n_cores / n_readers;
+    }
+
+    _core_n_readers = 1;
+    if (n_readers == 1)
+        return 0;
+
+    pthread_barrier_init(&_core_start, NULL, n_readers);
+    pthread_barrier_init(&_core_done, NULL, n_readers);
+
+    for (; _core_n_readers < n_readers; _core_n_readers++)
+    {
+        int ret = pthread_create(&_core_readers[_core_n_readers].thread, NULL, _cpu_core_reader,
+                                 &_core_readers[_core_n_readers]);
+        if (ret != 0)
+            return -ret;
+    }
+
+    return 0;
+}
+#endif /* CPU_PACKAGE */
+
+/**
+ * Initialize this CPU core module
+ *
+ * @param   cores[out]      Core structure to initialize all CPU cores and their rollups
+ * @param   dest_dir[in]    Directory contaning the files with the energy counters (NULL if disabled)
+ * @param   is_verbose[in]  Whether the verbose mode should be enabled
+ * @param   is_disabled[in] Whether the module should be disabled
+ */
+void cpu_core_init(Component_t *cores, const char *dest_dir, const bool is_verbose, const bool is_disabled)
+{
+    memset(cores, 0, sizeof(Component_t));
+    cores->is_verbose = is_verbose;
+    cores->type = CPU;
+    cores->vendor = get_vendor();
+    cores->fini = cpu_core_fini;
+    cores->update = cpu_core_update;
+
+#ifdef CPU_PACKAGE
+    if (is_disabled)
+        return;
+
+    if (cores->vendor != AMD)
+    {
+        fprintf(stderr, "CPU core energy counters are only available on AMD CPUs\n");
+        return;
+    }
+
+    /* The first hardware thread of every online core reads the counter of its core */
+    const uint32_t n_cpus = topology_n_cpus();
+
+    uint32_t *cpus = calloc(MAX(n_cpus, 1), sizeof(uint32_t));
+    uint64_t *keys = calloc(MAX(n_cpus, 1) * CORE_LEVELS_MAX, sizeof(uint64_t));
+    uint32_t (*parents)[CORE_LEVELS_MAX] = calloc(MAX(n_cpus, 1), sizeof(*parents));
+    uint32_t n_rollups[CORE_LEVELS_MAX] = { 0 };
+    if (cpus == NULL || keys == NULL || parents == NULL)
+    {
+        fprintf(stderr, "Unable to allocate the topology of %u CPUs\n", n_cpus);
+        exit(EXIT_FAILURE);
+    }
+
+    for (uint32_t cpu = 0; cpu < n_cpus; cpu++)
+    {
+        uint32_t first_thread, package, ids[CORE_LEVELS_MAX];
+
+        /* Offline CPUs do not have any topology */
+        if (topology_package(cpu, &package) != 0 ||
+            _cpu_core_read_sysfs(cpu, "topology/thread_siblings_list", &first_thread) != 0 ||
+            first_thread != cpu)
+            continue;
+
+        /* A CCX shares a L3 cache. Kernels not describing the CCDs report
+         * the die of the NUMA node. */
+        if (_cpu_core_read_sysfs(cpu, "cache/index3/id", &ids[CORE_CCX]) != 0 &&
+            _cpu_core_read_sysfs(cpu, "cache/index3/shared_cpu_list", &ids[CORE_CCX]) != 0)
+            ids[CORE_CCX] = 0;
+        if (topology_die(cpu, &ids[CORE_CCD]) != 0)
+            ids[CORE_CCD] = 0;
+        ids[CORE_PACKAGE] = 0;
+
+        for (int level = 0; level < CORE_LEVELS_MAX; level++)
+            parents[_core_n_cores][level] = _cpu_core_find_rollup(&keys[level * n_cpus], &n_rollups[level],
+                                                                  (uint64_t)package << 32 | ids[level]);
+        cpus[_core_n_cores++] = cpu;
+    }
+
+    uint32_t n_units = _core_n_cores;
+    for (int level = 0; level < CORE_LEVELS_MAX; level++)
+    {
+        for (uint32_t i = 0; i < _core_n_cores; i++)
+            parents[i][level] += n_units;
+        n_units += n_rollups[level];
+    }
+
+    if (component_alloc(cores, n_units) != 0)
+        exit(EXIT_FAILURE);
+
+    if (is_verbose)
+        printf("%s CPU(s) found with %u core(s), %u CCX(s), %u CCD(s) and %u package(s)\n",
+               vendor_str[cores->vendor], _core_n_cores, n_rollups[CORE_CCX], n_rollups[CORE_CCD],
+               n_rollups[CORE_PACKAGE]);
+
+    for (uint32_t i = 0; i < _core_n_cores; i++)
+    {
+        Unit_t *core = &cores->siblings[i];
+        core->id = cpus[i];
+
+        /* Keep the MSR device file opened for the lifetime of the daemon */
+        int ret = msr_open(core->id);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to open MSR file of CPU %u: %s\n", core->id, strerror(-ret));
+            exit(EXIT_FAILURE);
+        }
+
+        uint64_t msr_unit;
+        ret = msr_read(core->id, MSR_AMD_POWER_UNIT, &msr_unit);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to fetch energy unit of CPU core %u: %s\n", core->id, strerror(-ret));
+            exit(EXIT_FAILURE);
+        }
+
+        cores->counters.energy_scale[i] =
+            energy_scale(pow(0.5, (double)((msr_unit >> 8) & MSR_ENERGY_UNIT_MASK)) * UJ_PER_J);
+
+        /* Opening normalized file (Joules) */
+        snprintf(core->name, sizeof(core->name), "cpu_core_%u", core->id);
+        if (output_open(core, dest_dir) != 0)
+            exit(EXIT_FAILURE);
+    }
+
+    /* Rollups are numbered in the order they are found */
+    uint32_t i = _core_n_cores;
+    for (int level = 0; level < CORE_LEVELS_MAX; level++)
+        for (uint32_t j = 0; j < n_rollups[level]; j++, i++)
+        {
+            Unit_t *rollup = &cores->siblings[i];
+            rollup->id = (level == CORE_PACKAGE) ? (uint32_t)(keys[level * n_cpus + j] >> 32) : j;
+
+            snprintf(rollup->name, sizeof(rollup->name), "%s_%u", core_level_str[level], rollup->id);
+            if (output_open(rollup, dest_dir) != 0)
+                exit(EXIT_FAILURE);
+        }
+
+    /* Fetching first raw values */
+    if (_cpu_core_fetch_energy(cores, 0, _core_n_cores) != 0)
+        exit(EXIT_FAILURE);
+    memcpy(cores->counters.energy_raw, cores->counters.energy_raw_next, _core_n_cores * sizeof(uint64_t));
+
+    _core_parents = parents;
+    free(cpus);
+    free(keys);
+
+    /* One reader per CCX at most, as the cores of a CCX share their wake-ups */
+    int ret = _cpu_core_start_readers(cores, MAX(MIN(n_rollups[CORE_CCX], CORE_READERS_MAX), 1));
+    if (ret != 0)
+    {
+        fprintf(stderr, "Unable to start the CPU core readers: %s\n", strerror(-ret));
+        exit(EXIT_FAILURE);
+    }
+#endif /* CPU_PACKAGE */
+}
+
+/**
+ * Cleanup the module
+ *
+ * @param   cores[in]     Core structure to clean up
+ */
+void cpu_core_fini(Component_t *cores)
+{
+#ifdef CPU_PACKAGE
+    if (_core_n_readers > 1)
+    {
+        _core_is_stopping = true;
+        pthread_barrier_wait(&_core_start);
+
+        for (uint32_t i = 1; i < _core_n_readers; i++)
+            pthread_join(_core_readers[i].thread, NULL);
+
+        pthread_barrier_destroy(&_core_start);
+        pthread_barrier_destroy(&_core_done);
+    }
+    _core_n_readers = 0;
+
+    for (uint32_t i = 0; i < cores->n_siblings; ++i)
+    {
+        if (i < _core_n_cores)
+            msr_close(cores->siblings[i].id);
+        output_close(&cores->siblings[i]);
+    }
+
+    free(_core_parents);
+    _core_parents = NULL;
+    _core_n_cores = 0;
+#endif /* CPU_PACKAGE */
+}
+
+/**
+ * Retrieve last energy value for each core, roll them up and update the
+ * destination files
+ *
+ * @param   cores[inout] Core structure
+ */
+void cpu_core_update(Component_t *cores)
+{
+    const bool is_verbose = cores->is_verbose;
+    Counters_t *counters = &cores->counters;
+
+#ifdef CPU_PACKAGE
+    /* All readers fetch their cores at the same time */
+    if (_core_n_readers > 1)
+        pthread_barrier_wait(&_core_start);
+    _cpu_core_fetch_energy(cores, _core_readers[0].first, _core_readers[0].end);
+    if (_core_n_readers > 1)
+        pthread_barrier_wait(&_core_done);
+
+    /* Core energy counters are 32-bit wide */
+    counters_accumulate(counters, _core_n_cores, UINT32_MAX);
+
+    for (uint32_t i = _core_n_cores; i < cores->n_siblings; i++)
+    {
+        counters->energy_interval_uj[i] = 0;
+        counters->timestamp[i] = 0;
+    }
+
+    for (uint32_t i = 0; i < _core_n_cores; i++)
+        for (int level = 0; level < CORE_LEVELS_MAX; level++)
+        {
+            const uint32_t parent = _core_parents[i][level];
+
+            counters->energy_interval_uj[parent] += counters->energy_interval_uj[i];
+            counters->timestamp[parent] = MAX(counters->timestamp[parent], counters->timestamp[i]);
+        }
+
+    for (uint32_t i = _core_n_cores; i < cores->n_siblings; i++)
+        unit_add_energy(counters, i, counters->energy_interval_uj[i]);
+#endif /* CPU_PACKAGE */
+
+    for (uint32_t i = 0; i < cores->n_siblings; ++i)
+    {
+        /* Updating the file */
+        output_write(&cores->siblings[i], counters->energy_acc[i]);
+
+        if (is_verbose)
+            printf("%s %s: %lu J (accumulator: %lu J, raw: %lu)\n", vendor_str[cores->vendor],
+                   cores->siblings[i].name, counters->energy_interval[i], counters->energy_acc[i],
+                   counters->energy_raw[i]);
+    }
+}
@@ -33,13 +33,10 @@
 #include <string.h>
 #include <errno.h>
 #include <linux/limits.h>
-#include <math.h>
 #include "interface.h"
+#include "output.h"
 #include "common.h"
-
-#define MSR_INTEL_DRAM_PACKAGE_ENERGY  0x619
-
-static uint32_t _dram_package_to_core[N_SIBLINGS_MAX] = {0};
+#include "rapl.h"
 
 /* Prototypes used externaly */
 void dram_fini(Component_t *ram);
@@ -49,74 +46,33 @@ void dram_update(Component_t *ram);
 /**
  * Retrieve the current value of the DRAM energy counter for one CPU package
  *
- * @param   package[out]  Unit structure for the package
- * @param   vendor[in]    Vendor type
+ * @param   drams[inout]  DRAM structure
+ * @param   i[in]         Index of the package
+ * @return  0 on success, a negative error code otherwise
  */
-static void _dram_package_fetch_energy(Unit_t *package, const int vendor)
+static int _dram_package_fetch_energy(Component_t *drams, const uint32_t i)
 {
-    uint32_t core_id = _dram_package_to_core[package->id];
+    const RaplSample_t *sample = rapl_sample(drams->siblings[i].id, drams->tick);
 
-    switch (vendor)
+    if (sample->status[RAPL_DRAM] != 0)
     {
-        case INTEL:
-            package->energy_raw = read_msr(core_id, MSR_INTEL_DRAM_PACKAGE_ENERGY);
-            break;
-        default:
-            fprintf(stderr, "Unknown or supported CPU type: %d\n", vendor);
-            exit(EXIT_FAILURE);
+        fprintf(stderr, "Unable to fetch DRAM energy of package %u: %s\n", drams->siblings[i].id,
+                strerror(-sample->status[RAPL_DRAM]));
+        return sample->status[RAPL_DRAM];
     }
 
-    /* Return if resolution was already fetched */
-    if (package->energy_resolution > 0)
-        return;
-
-    uint64_t msr_unit;
-    switch (vendor)
-    {
-        case INTEL:
-            msr_unit = read_msr(core_id, MSR_INTEL_POWER_UNIT);
-            break;
-        case AMD:
-            msr_unit = read_msr(core_id, MSR_AMD_POWER_UNIT);
-            break;
-        default:
-            return;
-    }
+    drams->counters.energy_raw_next[i] = sample->energy_raw[RAPL_DRAM];
+    drams->counters.timestamp[i] = sample->timestamp;
 
-    package->energy_resolution = pow(0.5, (double)((msr_unit >> 8) & MSR_ENERGY_UNIT_MASK));
+    return 0;
 }
 #endif /* DRAM_PACKAGE */
 
-/**
- * Write latest DRAM counter value in the destination file for each CPU package
- *
- * @param   package[in]  Unit structure for the package
- * @param   vendor[in]   CPU vendor
- */
-static void _dram_package_update_files(Unit_t *package, const int vendor)
-{
-#ifdef DRAM_PACKAGE
-    uint64_t last_energy_raw = package->energy_raw;
-    _dram_package_fetch_energy(package, vendor);
-
-    if (package->energy_raw >= last_energy_raw)
-        package->energy_interval = package->energy_resolution * (package->energy_raw - last_energy_raw);
-    else /* Counter may wraparound  */
-        package->energy_interval = package->energy_resolution * (((1LU << 32) - last_energy_raw) + package->energy_raw);
-
-    package->energy_acc += package->energy_interval;
-
-    /* Updating the file */
-    fprintf(package->energy_fd, "%lu Joules", package->energy_acc);
-    rewind(package->energy_fd); /* Flush buffer and prepare for overwriting next value */
-#endif /* DRAM_PACKAGE */
-}
-
 /**
  * Initialize this DRAM module
  *
  * @param   drams[out]      DRAM structure to initialize all packages
- * @param   dest_dir[in]    Directory contaning the files with the energy counters
+ * @param   dest_dir[in]    Directory contaning the files with the energy counters (NULL if disabled)
  * @param   is_verbose[in]  Whether the verbose mode should be enabled
  * @param   is_disabled[in] Whether the module should be disabled
  */
@@ -136,45 +92,45 @@ void dram_init(Component_t *drams, const char *dest_dir, const bool is_verbose,
     if (is_disabled)
         return;
 
-    /* Get package mapping and amount of packages */
-    for(uint32_t i = 0;; i++)
+    if (rapl_init(drams->vendor) != 0)
+        exit(EXIT_FAILURE);
+
+    if (rapl_enable(RAPL_DRAM) != 0)
     {
-        char file_path[PATH_MAX];
-        uint32_t package_id;
-        snprintf(file_path, PATH_MAX, "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", i);
-
-        FILE *file = fopen(file_path,"r");
-        if (file == NULL)
-            break;
-
-        fscanf(file,"%u", &package_id);
-        fclose(file);
-        drams->n_siblings = MAX(drams->n_siblings, package_id + 1);
-        _dram_package_to_core[package_id] = i;
+        fprintf(stderr, "DRAM energy counters are not available\n");
+        rapl_fini();
+        return;
     }
 
+    uint32_t n_packages = 0;
+    for (uint32_t j = 0; j < rapl_n_packages(); j++)
+        n_packages += rapl_is_available(j, RAPL_DRAM);
+
+    if (component_alloc(drams, n_packages) != 0)
+        exit(EXIT_FAILURE);
+
     if (is_verbose)
         printf("DRAM(s) found with %u CPU package(s)\n", drams->n_siblings);
 
-    assert(drams->n_siblings < N_SIBLINGS_MAX);
+    for (uint32_t i = 0, j = 0; j < rapl_n_packages(); j++) {
+        if (!rapl_is_available(j, RAPL_DRAM))
+            continue;
 
-    for (uint32_t i = 0; i < drams->n_siblings; i++) {
         Unit_t *package = &drams->siblings[i];
-        package->id = i;
+        package->id = j;
 
-        /* Fetching first raw value */
-        _dram_package_fetch_energy(package, drams->vendor);
+        drams->counters.energy_scale[i] = energy_scale(rapl_energy_resolution(j, RAPL_DRAM) * UJ_PER_J);
 
-        char output_path[PATH_MAX];
+        /* Fetching first raw value */
+        if (_dram_package_fetch_energy(drams, i) != 0)
+            exit(EXIT_FAILURE);
+        drams->counters.energy_raw[i] = drams->counters.energy_raw_next[i];
 
         /* Opening normalized file (Joules) */
-        snprintf(output_path, sizeof(output_path), "%s/dram_package_%d_energy", dest_dir, package->id);
-        package->energy_fd = fopen(output_path, "w");
-        if (!package->energy_fd)
-        {
-            fprintf(stderr, "Failed to open output file: %s\n", output_path);
+        snprintf(package->name, sizeof(package->name), "dram_package_%d", package->id);
+        if (output_open(package, dest_dir) != 0)
             exit(EXIT_FAILURE);
-        }
+        i++;
     }
 #endif /* DRAM_PACKAGE */
 }
@@ -190,8 +146,11 @@ void dram_fini(Component_t *drams)
     for (uint32_t i = 0; i < drams->n_siblings; ++i)
     {
         Unit_t *package = &drams->siblings[i];
-        fclose(package->energy_fd);
+        output_close(package);
     }
+
+    if (drams->n_siblings > 0)
+        rapl_fini();
 #endif /* DRAM_PACKAGE */
 }
 
@@ -203,15 +162,27 @@ void dram_fini(Component_t *drams)
 void dram_update(Component_t *drams)
 {
     const bool is_verbose = drams->is_verbose;
+    Counters_t *counters = &drams->counters;
+
+#ifdef DRAM_PACKAGE
+    /* A counter which cannot be read keeps its last value, the energy
+     * will be accounted during the next successful read */
+    for (uint32_t i = 0; i < drams->n_siblings; ++i)
+        if (_dram_package_fetch_energy(drams, i) != 0)
+            counters->energy_raw_next[i] = counters->energy_raw[i];
+
+    /* The sampler unrolls the wraparound of the RAPL counters */
+    counters_accumulate(counters, drams->n_siblings, UINT64_MAX);
+#endif /* DRAM_PACKAGE */
 
     for (uint32_t i = 0; i < drams->n_siblings; ++i)
     {
-        Unit_t *package = &drams->siblings[i];
-        _dram_package_update_files(package, drams->vendor);
+        /* Updating the file */
+        output_write(&drams->siblings[i], counters->energy_acc[i]);
 
         if (is_verbose)
             printf("DRAM package %u: %lu J (accumulator: %lu J, raw: %lu)\n",
-                   i, package->energy_interval, package->energy_acc, package->energy_raw);
+                   drams->siblings[i].id, counters->energy_interval[i], counters->energy_acc[i], counters->energy_raw[i]);
     }
 }
 
@@ -35,19 +35,30 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <netinet/in.h>
 #include "interface.h"
+#include "common.h"
+#include "scheduler.h"
+#include "shm.h"
+#include "snapshot.h"
+#include "output.h"
+#include "history.h"
+#include "rollup.h"
+#include "rapl.h"
+#include "topology.h"
+#include "worker.h"
 
 /* Expand macro values to string */
 #define STR_VALUE(var)  #var
 #define STR(var)        STR_VALUE(var)
 
-#define MIN(a,b) (((a)<(b))?(a):(b))
-#define MAX(a,b) (((a)>(b))?(a):(b))
-
 #define VERSION  "0.1"
 #define CONTACT  "https://github.com/HewlettPackard/EnergyCounter"
 
 #define INTERVAL_DEFAULT  10              /* Default interval in seconds before next collection */
+#define INTERVAL_MIN_MS   1               /* Minimum interval in milliseconds                   */
 #define DIR_PATH_DEFAULT  "/tmp/ecounter" /* Default directory path to store the counters       */
 
 #define ARG_CPU        0x200
@@ -55,14 +66,57 @@
 #define ARG_GPU_AMD    0x400
 #define ARG_GPU_INTEL  0x500
 #define ARG_GPU_NVIDIA 0x600
+#define ARG_INTERVAL_CPU  0x700
+#define ARG_INTERVAL_DRAM 0x800
+#define ARG_INTERVAL_GPU  0x900
+#define ARG_INTERVAL_MOCK 0xa00
+#define ARG_SHM           0xb00
+#define ARG_DISABLE_FILES 0xc00
+#define ARG_SNAPSHOT      0xd00
+#define ARG_SOCKET        0xe00
+#define ARG_HTTP          0xf00
+#define ARG_HISTORY       0x1000
+#define ARG_ROLLUP        0x1100
+#define ARG_JOURNAL       0x1200
+#define ARG_CHECKPOINT    0x1300
+#define ARG_CPU_CORES     0x1400
+#define ARG_RAPL_BACKEND  0x1500
+#define ARG_RAPL_THREADS  0x1600
+
+#define SOCKET_NAME_DEFAULT "ecounter.sock"
+#define HTTP_ADDRESS_DEFAULT "127.0.0.1"
 
 extern void cpu_init(Component_t *, const char * dir_path, const bool is_verbose, const bool is_disabled);
+extern void cpu_core_init(Component_t *, const char * dir_path, const bool is_verbose, const bool is_disabled);
 extern void dram_init(Component_t *, const char * dir_path, const bool is_verbose, const bool is_disabled);
 extern void amd_gpu_init(Component_t *, const char *dir_path, const bool is_verbose, const bool is_disabled);
 extern void intel_gpu_init(Component_t *, const char *dir_path, const bool is_verbose, const bool is_disabled);
 extern void nvidia_gpu_init(Component_t *, const char *dir_path, const bool is_verbose, const bool is_disabled);
 extern void mock_init(Component_t *, const char *dir_path, const bool is_verbose,
-                      const uint32_t n_mocks, uint32_t *mock_watts, const uint32_t interval);
+                      const uint32_t n_mocks, uint32_t *mock_watts, const uint64_t interval_ms);
+extern int shm_init(const char *name, const Component_t *components, const uint32_t n_components);
+extern void shm_fini(void);
+extern void shm_publish(const Component_t *components, const uint32_t n_components,
+                        const uint64_t tick, const uint64_t generation);
+extern int query_init(const char *path, Scheduler_t *sched, const Component_t *components,
+                      const uint32_t n_components);
+extern void query_fini(void);
+extern void query_publish(const uint64_t generation);
+extern int http_init(const char *address, const uint16_t port, Scheduler_t *sched,
+                     const Component_t *components, const uint32_t n_components);
+extern void http_fini(void);
+extern int journal_init(const char *dir_path, const Component_t *components,
+                        const uint32_t n_components);
+extern void journal_fini(void);
+extern void journal_record(const Component_t *components, const uint32_t n_components,
+                           const uint64_t tick);
+extern int checkpoint_init(const char *path, Component_t *components, const uint32_t n_components,
+                           const bool is_verbose);
+extern void checkpoint_fini(void);
+extern void checkpoint_record(const Component_t *components, const uint32_t n_components,
+                              const uint64_t tick);
+extern void http_publish(const Component_t *components, const uint32_t n_components,
+                         const uint64_t generation);
 
 typedef struct Overhead
 {
@@ -70,16 +124,33 @@ typedef struct Overhead
     uint32_t max;
     uint32_t mov_average;
     uint32_t n_samples;
+    uint64_t last_energy_acc_uj;
+    uint64_t last_timestamp;
 } Overhead_t;
 
 typedef struct Ecounter
 {
     Component_t  components[INTERFACES_MAX];  /* Structure for all components               */
     bool         is_disabled[INTERFACES_MAX]; /* Defines if the component is disabled       */
-    uint32_t     interval;                    /* Interval in seconds before next collection */
+    uint64_t     interval_ms;                 /* Interval in ms before next collection      */
+    uint64_t     intervals_ms[INTERFACES_MAX];/* Per component interval in ms (0: default)  */
+    Scheduler_t  sched;                       /* Scheduler for all periodic tasks           */
+    Watch_t      signals;                     /* Termination signals (signalfd)             */
+    uint64_t     generation;                  /* Amount of publications                     */
+    bool         is_files_disabled;           /* Defines if the output files are disabled   */
+    char         shm_name[NAME_MAX];          /* Shared memory segment name (empty: none)   */
+    uint32_t     snapshot_formats;            /* Bitmask of enabled snapshot formats        */
+    bool         is_socket_enabled;           /* Defines if the query socket is served      */
+    char         socket_path[PATH_MAX];       /* Query socket path (empty: in the directory)*/
+    char         http_address[INET_ADDRSTRLEN]; /* Address of the HTTP endpoint               */
+    uint16_t     http_port;                   /* Port of the HTTP endpoint (0: disabled)    */
+    uint32_t     history_len;                 /* Samples kept in memory per unit            */
+    bool         is_rollup_enabled;           /* Defines if the rollups are maintained      */
+    char         journal_path[PATH_MAX];      /* Directory of the journal (empty: disabled) */
+    char         checkpoint_path[PATH_MAX];   /* Checkpoint file (empty: disabled)          */
     bool         is_verbose;                  /* Defines if verbose mod is enabled          */
     uint32_t     n_mocks;                     /* Amount of mock units                       */
-    uint32_t     mock_watts[N_SIBLINGS_MAX];  /* All fixed power consumptions for mocks     */
+    uint32_t    *mock_watts;                  /* All fixed power consumptions for mocks     */
     char         dir_path[PATH_MAX];          /* Directory path to store the counters       */
     char         power_cmd[PATH_MAX];         /* Command to fetch instantaneous node power  */
     Overhead_t   overhead;                    /* Evaluation of power overhead               */
@@ -97,7 +168,7 @@ static char doc[] = "This application is designed to periodically fetch energy c
                     "are supported. The application accepts the following arguments:";
 
 /* A description of the arguments we accept (in addition to the options) */
-static char args_doc[] = "--dir=<path> --interval=<seconds>";
+static char args_doc[] = "--dir=<path> --interval=<duration>";
 
 /* Options */
 static struct argp_option options[] =
@@ -106,9 +177,25 @@ static struct argp_option options[] =
                                                  "Should be in a tmpfs or ramfs mount point "
                                                  "to avoid wearing out a storage device [default: "
                                                  STR(DIR_PATH_DEFAULT) "]"},
+    {"checkpoint",    ARG_CHECKPOINT, "<path>", 0, "Persist the accumulators in a checkpoint file "
+                                                 "updated after each collection, so counters "
+                                                 "resume from it after a restart"},
+    {"disable-files", ARG_DISABLE_FILES,   0, 0, "Do not write one file per energy counter"},
 #ifdef CPU_PACKAGE
     {"disable-cpu",  ARG_CPU,              0, 0, "Disable CPU energy support"},
+    {"cpu-cores",    ARG_CPU_CORES,        0, 0, "Collect the energy of every CPU core (AMD CPUs "
+                                                 "only), rolled up per CCX, CCD and package"},
 #endif /* CPU_PACKAGE */
+    {"rapl-backend",  ARG_RAPL_BACKEND, "<backend>", 0, "Read the CPU and DRAM energy counters from "
+                                                 "the MSRs (msr), the power PMU of perf_event (perf) "
+                                                 "or powercap (powercap) [default: auto, first "
+                                                 "available in this order]"},
+    {"rapl-threads",  ARG_RAPL_THREADS, "<cpus>", OPTION_ARG_OPTIONAL,
+                                                 "Read the CPU and DRAM energy counters of each "
+                                                 "package from a thread pinned to one of its CPUs, "
+                                                 "given as a comma-separated list of housekeeping "
+                                                 "CPUs, at most one per package [default: first "
+                                                 "online CPU of each package]"},
 #ifdef DRAM_PACKAGE
     {"disable-dram", ARG_DRAM,             0, 0, "Disable DRAM energy support"},
 #endif /* DRAM_PACKAGE */
@@ -121,19 +208,85 @@ static struct argp_option options[] =
 #ifdef NVIDIA_GPU
     {"disable-gpu-nvidia", ARG_GPU_NVIDIA, 0, 0, "Disable NVIDIA GPU support"},
 #endif /* NVIDA_GPU */
-    {"interval",      'i', "<seconds>",       0, "Specify the intertval time in seconds "
-                                                 "before collecting new values [default: "
+    {"interval",      'i', "<duration>",      0, "Specify the interval time before collecting "
+                                                 "new values, in seconds or with a unit suffix "
+                                                 "(e.g. 100ms, 0.5s) [default: "
                                                  STR(INTERVAL_DEFAULT) "s]"},
+    {"interval-cpu",  ARG_INTERVAL_CPU,  "<duration>", 0, "Specify the interval time for CPU packages "
+                                                 "and cores [default: same as --interval]"},
+    {"interval-dram", ARG_INTERVAL_DRAM, "<duration>", 0, "Specify the interval time for DRAM "
+                                                 "[default: same as --interval]"},
+    {"interval-gpu",  ARG_INTERVAL_GPU,  "<duration>", 0, "Specify the interval time for all GPUs "
+                                                 "[default: same as --interval]"},
+    {"interval-mock", ARG_INTERVAL_MOCK, "<duration>", 0, "Specify the interval time for mock units "
+                                                 "[default: same as --interval]"},
     {"mock",          'm', "<watts>",         0, "Add a mock energy counter based on a fixed power "
                                                  "consumption budget defined in watts. Multiple mock "
                                                  "counters can be created by repeating this option"},
     {"find-overhead", 'o', "<cmd>",           0, "Mode to find the power overhead. This option takes "
                                                  "a bash command or script as argument which should "
                                                  "return the instantaneous power consumption of the node"},
+    {"shm",           ARG_SHM, "<name>", OPTION_ARG_OPTIONAL,
+                                                 "Publish all energy counters in a POSIX shared "
+                                                 "memory segment [default name: "
+                                                 STR(ECOUNTER_SHM_NAME_DEFAULT) "]"},
+    {"snapshot",      ARG_SNAPSHOT, "<format>", 0, "Write a consolidated snapshot of all energy "
+                                                 "counters in the directory, atomically replaced "
+                                                 "after each collection. Formats: json, kv "
+                                                 "(key=value) or prom (Prometheus textfile). Multiple "
+                                                 "formats can be enabled by repeating this option"},
+    {"socket",        ARG_SOCKET, "<path>", OPTION_ARG_OPTIONAL,
+                                                 "Answer queries on a local (AF_UNIX) socket "
+                                                 "[default path: <dir>/" SOCKET_NAME_DEFAULT "]"},
+    {"history",       ARG_HISTORY, "<samples>", 0, "Keep the last samples of every unit in memory "
+                                                 "to answer energy and power queries on past "
+                                                 "time ranges (see --socket) [default: 0]"},
+    {"journal",       ARG_JOURNAL, "<path>", 0, "Append every raw counter read to a compressed "
+                                                 "journal in a directory, segments rotate every "
+                                                 "16 MiB (see ecounter-dump)"},
+    {"rollup",        ARG_ROLLUP,       0, 0, "Maintain the energy and the min/mean/max power "
+                                                 "of every unit at 1s, 10s, 1m and 1h resolutions "
+                                                 "(see --socket)"},
+    {"http",          ARG_HTTP, "[<address>:]<port>", 0,
+                                                 "Serve the energy counters in the Prometheus "
+                                                 "format on a TCP port [default address: "
+                                                 HTTP_ADDRESS_DEFAULT "]"},
     {"verbose",       'v',  0,                0, "Enable verbosity"},
     {0}
 };
 
+/**
+ * Parse a duration given in seconds or with a unit suffix (ms or s)
+ *
+ * @param   arg[in]          Argument to parse
+ * @param   interval_ms[out] Parsed duration in milliseconds
+ * @return  true if the argument is a valid duration, false otherwise
+ */
+static bool parse_interval(const char *arg, uint64_t *interval_ms)
+{
+    char *end;
+
+    errno = 0;
+    const double value = strtod(arg, &end);
+    if (errno != 0 || end == arg || value <= 0)
+        return false;
+
+    double ms;
+    if (strcmp(end, "ms") == 0)
+        ms = value;
+    else if (strcmp(end, "s") == 0 || *end == '\0')
+        ms = value * 1E3;
+    else
+        return false;
+
+    if (ms < INTERVAL_MIN_MS)
+        return false;
+
+    *interval_ms = (uint64_t)ms;
+
+    return true;
+}
+
 /* Parse a single option */
 static error_t parse_opt(int key, char *arg, struct argp_state *state)
 {
@@ -144,6 +297,9 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
         case ARG_CPU:
             ec->is_disabled[CPUS] = true;
             break;
+        case ARG_CPU_CORES:
+            ec->is_disabled[CPU_CORES] = false;
+            break;
         case ARG_DRAM:
             ec->is_disabled[DRAMS] = true;
             break;
@@ -159,16 +315,150 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
         case 'd':
             strncpy(ec->dir_path, arg, PATH_MAX - 1);
             break;
+        case ARG_DISABLE_FILES:
+            ec->is_files_disabled = true;
+            break;
+        case ARG_SHM:
+            strncpy(ec->shm_name, (arg != NULL) ? arg : ECOUNTER_SHM_NAME_DEFAULT, NAME_MAX - 1);
+            break;
         case 'i':
-            ec->interval = strtol(arg, NULL, 10);
-            if (errno == EINVAL || errno == ERANGE || ec->interval < 0)
+            if (!parse_interval(arg, &ec->interval_ms))
             {
-                fprintf(stderr, "Error: cannot parse the amount of seconds from the "
+                fprintf(stderr, "Error: cannot parse the duration from the "
                                 "--interval argument (%s). Exit.\n", arg);
                 exit(EXIT_FAILURE);
             }
             break;
+        case ARG_INTERVAL_CPU:
+        case ARG_INTERVAL_DRAM:
+        case ARG_INTERVAL_GPU:
+        case ARG_INTERVAL_MOCK:
+        {
+            uint64_t interval_ms;
+            if (!parse_interval(arg, &interval_ms))
+            {
+                fprintf(stderr, "Error: cannot parse the duration from the "
+                                "interval argument (%s). Exit.\n", arg);
+                exit(EXIT_FAILURE);
+            }
+
+            if (key == ARG_INTERVAL_CPU)
+            {
+                ec->intervals_ms[CPUS] = interval_ms;
+                ec->intervals_ms[CPU_CORES] = interval_ms;
+            }
+            else if (key == ARG_INTERVAL_DRAM)
+                ec->intervals_ms[DRAMS] = interval_ms;
+            else if (key == ARG_INTERVAL_MOCK)
+                ec->intervals_ms[MOCKS] = interval_ms;
+            else
+            {
+                ec->intervals_ms[AMD_GPUS] = interval_ms;
+                ec->intervals_ms[INTEL_GPUS] = interval_ms;
+                ec->intervals_ms[NVIDIA_GPUS] = interval_ms;
+            }
+            break;
+        }
+        case ARG_SOCKET:
+            ec->is_socket_enabled = true;
+            if (arg != NULL)
+                strncpy(ec->socket_path, arg, PATH_MAX - 1);
+            break;
+        case ARG_HISTORY:
+        {
+            char *end;
+            const unsigned long value = strtoul(arg, &end, 10);
+            if (*arg == '\0' || *end != '\0' || value > HISTORY_CAPACITY_MAX)
+            {
+                fprintf(stderr, "Error: cannot parse the amount of samples from the "
+                                "--history argument (%s). Exit.\n", arg);
+                exit(EXIT_FAILURE);
+            }
+            ec->history_len = value;
+            break;
+        }
+        case ARG_ROLLUP:
+            ec->is_rollup_enabled = true;
+            break;
+        case ARG_JOURNAL:
+            strncpy(ec->journal_path, arg, PATH_MAX - 1);
+            break;
+        case ARG_CHECKPOINT:
+            strncpy(ec->checkpoint_path, arg, PATH_MAX - 1);
+            break;
+        case ARG_HTTP:
+        {
+            const char *port = strrchr(arg, ':');
+            char *end;
+
+            if (port != NULL)
+            {
+                const size_t len = MIN((size_t)(port - arg), sizeof(ec->http_address) - 1);
+                memcpy(ec->http_address, arg, len);
+                ec->http_address[len] = '\0';
+                port++;
+            }
+            else
+                port = arg;
+
+            const unsigned long value = strtoul(port, &end, 10);
+            if (*port == '\0' || *end != '\0' || value == 0 || value > UINT16_MAX)
+            {
+                fprintf(stderr, "Error: cannot parse the port from the --http argument (%s). Exit.\n", arg);
+                exit(EXIT_FAILURE);
+            }
+            ec->http_port = value;
+            break;
+        }
+        case ARG_RAPL_BACKEND:
+        {
+            int backend;
+            for (backend = 0; backend < RAPL_BACKENDS_MAX; backend++)
+                if (strcmp(arg, rapl_backend_str[backend]) == 0)
+                    break;
+
+            if (backend == RAPL_BACKENDS_MAX)
+            {
+                fprintf(stderr, "Error: unknown RAPL backend (%s). Exit.\n", arg);
+                exit(EXIT_FAILURE);
+            }
+
+            rapl_set_backend(backend);
+            break;
+        }
+        case ARG_RAPL_THREADS:
+            if (rapl_set_threads(arg) != 0)
+            {
+                fprintf(stderr, "Error: invalid list of housekeeping CPUs (%s). Exit.\n", arg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case ARG_SNAPSHOT:
+        {
+            int format;
+            for (format = 0; format < SNAPSHOT_FORMATS_MAX; format++)
+                if (strcmp(arg, snapshot_format_str[format]) == 0)
+                    break;
+
+            if (format == SNAPSHOT_FORMATS_MAX)
+            {
+                fprintf(stderr, "Error: unknown snapshot format (%s). Exit.\n", arg);
+                exit(EXIT_FAILURE);
+            }
+
+            ec->snapshot_formats |= (1U << format);
+            break;
+        }
         case 'm':
+        {
+            uint32_t *mock_watts = realloc(ec->mock_watts, (ec->n_mocks + 1) * sizeof(uint32_t));
+            if (mock_watts == NULL)
+            {
+                fprintf(stderr, "Error: cannot allocate mock unit. Exit.\n");
+                exit(EXIT_FAILURE);
+            }
+            ec->mock_watts = mock_watts;
+
             ec->mock_watts[ec->n_mocks] = strtol(arg, NULL, 10);
             if (errno == EINVAL || errno == ERANGE || ec->mock_watts[ec->n_mocks] < 0)
             {
@@ -178,6 +468,7 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
             }
             ec->n_mocks++;
             break;
+        }
         case 'o':
             strncpy(ec->power_cmd, arg, PATH_MAX - 1);
             break;
@@ -239,25 +530,43 @@ uint32_t fetch_node_power(Ecounter_t *ec)
 }
 
 /**
- * Compute the power overhead over the last interval
+ * Compute the power overhead since the last evaluation
  *
- * @param   ec[in]     Main application structure
+ * @param   arg[in]    Main application structure
  */
-void compute_overhead(Ecounter_t *ec)
+static void compute_overhead(void *arg)
 {
+    Ecounter_t *ec = (Ecounter_t *)arg;
     Overhead_t *overhead = &ec->overhead;
     const uint32_t node_power = fetch_node_power(ec);
-    uint32_t energy_interval = 0;
+    uint64_t energy_acc_uj = 0;
+
+    /* Components of this round are collected first */
+    workers_wait();
+    const uint64_t now = get_time_ns();
 
     for (uint32_t i = 0; i < INTERFACES_MAX; i++)
     {
         Component_t *component = &ec->components[i];
 
         for (uint32_t j = 0; j < component->n_siblings; j++)
-            energy_interval += component->siblings[j].energy_interval;
+            energy_acc_uj += component->counters.energy_acc_uj[j];
     }
 
-    const uint32_t power_interval = energy_interval / ec->interval;
+    /* Components may run at different rates, use the accumulators to get
+     * the energy consumed since the last evaluation */
+    const uint64_t energy_interval_uj = energy_acc_uj - overhead->last_energy_acc_uj;
+    const uint64_t elapsed = now - overhead->last_timestamp;
+    const bool is_first = (overhead->last_timestamp == 0);
+
+    overhead->last_energy_acc_uj = energy_acc_uj;
+    overhead->last_timestamp = now;
+
+    if (is_first)
+        return;
+
+    /* In double: energy_interval_uj * NS_PER_S overflows 64 bits beyond about 18 kJ */
+    const uint32_t power_interval = (double)energy_interval_uj / UJ_PER_J * NS_PER_S / elapsed;
     const uint32_t overhead_interval = (power_interval < node_power) ?
                                        node_power - power_interval : 0;
 
@@ -276,6 +585,65 @@ void compute_overhead(Ecounter_t *ec)
             overhead->min, overhead->max, overhead->mov_average);
 }
 
+/**
+ * Start the collection of the energy counters of a component, components
+ * of a same round are collected in parallel
+ *
+ * @param   arg[in/out]   Component structure
+ */
+static void update_component(void *arg)
+{
+    Component_t *component = (Component_t *)arg;
+
+    component->tick = ec_g.sched.n_rounds;
+    workers_post(component);
+}
+
+/**
+ * Read the RAPL counters between two collections, so none of their
+ * wraparounds is missed
+ *
+ * @param   arg[in]    Unused
+ */
+static void refresh_rapl(void *arg)
+{
+    (void)arg;
+
+    /* The CPU or DRAM collection of this round already read the counters */
+    workers_wait();
+    rapl_refresh(ec_g.sched.n_rounds);
+}
+
+/**
+ * Move the readers of the CPU packages after a CPU went online or offline
+ *
+ * @param   arg[in]    Unused
+ */
+static void remap_topology(void *arg)
+{
+    (void)arg;
+    rapl_remap();
+}
+
+/**
+ * Stop the event loop on a termination signal, so the daemon stops between
+ * two rounds and never while a collection waits on its threads
+ *
+ * @param   arg[in/out]   Main application structure
+ * @param   events[in]    Epoll events
+ */
+static void handle_signals(void *arg, const uint32_t events)
+{
+    Ecounter_t *ec = (Ecounter_t *)arg;
+    struct signalfd_siginfo info;
+
+    (void)events;
+    while (read(ec->signals.fd, &info, sizeof(info)) == sizeof(info))
+        ;
+
+    sched_stop(&ec->sched);
+}
+
 /**
  * Initialize the application
  *
@@ -288,8 +656,9 @@ void init(int argc, char *argv[], Ecounter_t *ec)
     memset(ec, 0, sizeof(Ecounter_t));
 
     /* Set defaults */
-    ec->interval = INTERVAL_DEFAULT;
+    ec->interval_ms = INTERVAL_DEFAULT * 1E3;
     strncpy(ec->dir_path, DIR_PATH_DEFAULT, PATH_MAX - 1);
+    ec->is_disabled[CPU_CORES] = true;
 
     argp_parse(&argp, argc, argv, 0, 0, ec);
 
@@ -315,13 +684,168 @@ void init(int argc, char *argv[], Ecounter_t *ec)
 
     ec->overhead.min = INT_MAX;
 
-    amd_gpu_init(&ec->components[AMD_GPUS], ec->dir_path, ec->is_verbose, ec->is_disabled[AMD_GPUS]);
-    intel_gpu_init(&ec->components[INTEL_GPUS], ec->dir_path, ec->is_verbose, ec->is_disabled[INTEL_GPUS]);
-    nvidia_gpu_init(&ec->components[NVIDIA_GPUS], ec->dir_path, ec->is_verbose, ec->is_disabled[NVIDIA_GPUS]);
-    cpu_init(&ec->components[CPUS], ec->dir_path, ec->is_verbose, ec->is_disabled[CPUS]);
-    dram_init(&ec->components[DRAMS], ec->dir_path, ec->is_verbose, ec->is_disabled[DRAMS]);
-    mock_init(&ec->components[MOCKS], ec->dir_path, ec->is_verbose,
-              ec->n_mocks, ec->mock_watts, ec->interval);
+    /* Components without a specific interval use the default one */
+    for (int i = 0; i < INTERFACES_MAX; i++)
+        if (ec->intervals_ms[i] == 0)
+            ec->intervals_ms[i] = ec->interval_ms;
+
+    /* Modules share the topology parsed once */
+    ret = topology_init();
+    if (ret != 0)
+        fprintf(stderr, "Unable to parse the CPU topology: %s\n", strerror(-ret));
+
+    /* Modules do not open any file without a destination directory */
+    const char *dest_dir = ec->is_files_disabled ? NULL : ec->dir_path;
+
+    amd_gpu_init(&ec->components[AMD_GPUS], dest_dir, ec->is_verbose, ec->is_disabled[AMD_GPUS]);
+    intel_gpu_init(&ec->components[INTEL_GPUS], dest_dir, ec->is_verbose, ec->is_disabled[INTEL_GPUS]);
+    nvidia_gpu_init(&ec->components[NVIDIA_GPUS], dest_dir, ec->is_verbose, ec->is_disabled[NVIDIA_GPUS]);
+    cpu_init(&ec->components[CPUS], dest_dir, ec->is_verbose, ec->is_disabled[CPUS]);
+    cpu_core_init(&ec->components[CPU_CORES], dest_dir, ec->is_verbose, ec->is_disabled[CPU_CORES]);
+    dram_init(&ec->components[DRAMS], dest_dir, ec->is_verbose, ec->is_disabled[DRAMS]);
+    mock_init(&ec->components[MOCKS], dest_dir, ec->is_verbose,
+              ec->n_mocks, ec->mock_watts, ec->intervals_ms[MOCKS]);
+
+    /* Resume the accumulators before any publication */
+    if (strlen(ec->checkpoint_path) > 0)
+    {
+        ret = checkpoint_init(ec->checkpoint_path, ec->components, INTERFACES_MAX, ec->is_verbose);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Error: unable to open checkpoint %s (%s). Exit\n",
+                    ec->checkpoint_path, strerror(-ret));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (strlen(ec->shm_name) > 0)
+    {
+        ret = shm_init(ec->shm_name, ec->components, INTERFACES_MAX);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Error: unable to create shared memory segment %s (%s). Exit\n",
+                    ec->shm_name, strerror(-ret));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    snapshot_init(ec->dir_path, ec->snapshot_formats);
+    history_init(ec->components, INTERFACES_MAX, ec->history_len);
+    if (ec->is_rollup_enabled)
+        rollup_init(ec->components, INTERFACES_MAX);
+
+    if (strlen(ec->journal_path) > 0)
+    {
+        ret = mkdir(ec->journal_path, 0755);
+        if (ret == 0 || errno == EEXIST)
+            ret = journal_init(ec->journal_path, ec->components, INTERFACES_MAX);
+        else
+            ret = -errno;
+
+        if (ret != 0)
+        {
+            fprintf(stderr, "Error: unable to create the journal in %s (%s). Exit\n",
+                    ec->journal_path, strerror(-ret));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* Readers of the directory are notified once all files are updated */
+    output_generation_init((dest_dir != NULL || ec->snapshot_formats != 0) ? ec->dir_path : NULL);
+
+    /* Each component with units is collected at its own rate */
+    sched_init(&ec->sched);
+
+    /* SIGTERM is blocked by main() before any thread starts */
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGTERM);
+    ec->signals.fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    ec->signals.handle = handle_signals;
+    ec->signals.arg = ec;
+    if (ec->signals.fd < 0 || sched_watch(&ec->sched, &ec->signals, EPOLLIN) != 0)
+    {
+        fprintf(stderr, "Error: unable to watch termination signals (%s). Exit\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < INTERFACES_MAX; i++)
+    {
+        Component_t *component = &ec->components[i];
+        if (component->n_siblings == 0)
+            continue;
+
+        sched_add(&ec->sched, interface_str[i], ec->intervals_ms[i] * NS_PER_MS,
+                  update_component, component);
+    }
+
+    /* The 32-bit RAPL MSRs may wrap faster than the collection interval */
+    const uint64_t rapl_period_ns = rapl_wrap_period_ns() / 2;
+    uint64_t rapl_interval_ns = 0;
+    if (ec->components[CPUS].n_siblings > 0)
+        rapl_interval_ns = ec->intervals_ms[CPUS] * NS_PER_MS;
+    if (ec->components[DRAMS].n_siblings > 0)
+        rapl_interval_ns = MAX(rapl_interval_ns, ec->intervals_ms[DRAMS] * NS_PER_MS);
+
+    if (rapl_interval_ns > rapl_period_ns)
+    {
+        if (ec->is_verbose)
+            printf("RAPL counters wrap in %lu s at worst, reading them every %lu ms\n",
+                   (unsigned long)(2 * rapl_period_ns / NS_PER_S),
+                   (unsigned long)(rapl_period_ns / NS_PER_MS));
+        sched_add(&ec->sched, "rapl", rapl_period_ns, refresh_rapl, NULL);
+    }
+
+    /* Sampling never targets an offline CPU */
+    if (ec->components[CPUS].n_siblings > 0 || ec->components[CPU_CORES].n_siblings > 0 ||
+        ec->components[DRAMS].n_siblings > 0)
+    {
+        ret = topology_watch(&ec->sched, remap_topology, NULL);
+        if (ret != 0)
+            fprintf(stderr, "Unable to watch CPU hotplug events: %s\n", strerror(-ret));
+    }
+
+    ret = workers_init(ec->components, INTERFACES_MAX);
+    if (ret != 0)
+    {
+        fprintf(stderr, "Error: unable to start the collection workers (%s). Exit\n", strerror(-ret));
+        exit(EXIT_FAILURE);
+    }
+
+    if (strlen(ec->power_cmd) > 0)
+        sched_add(&ec->sched, "overhead", ec->interval_ms * NS_PER_MS, compute_overhead, ec);
+
+    /* Queries are served by the event loop between two collections */
+    if (ec->is_socket_enabled)
+    {
+        ret = 0;
+        if (strlen(ec->socket_path) == 0 &&
+            snprintf(ec->socket_path, PATH_MAX, "%s/%s", ec->dir_path, SOCKET_NAME_DEFAULT) >= PATH_MAX)
+            ret = -ENAMETOOLONG;
+
+        if (ret == 0)
+            ret = query_init(ec->socket_path, &ec->sched, ec->components, INTERFACES_MAX);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Error: unable to create query socket %s (%s). Exit\n",
+                    ec->socket_path, strerror(-ret));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (ec->http_port != 0)
+    {
+        if (strlen(ec->http_address) == 0)
+            strncpy(ec->http_address, HTTP_ADDRESS_DEFAULT, sizeof(ec->http_address) - 1);
+
+        ret = http_init(ec->http_address, ec->http_port, &ec->sched, ec->components, INTERFACES_MAX);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Error: unable to listen on %s:%u (%s). Exit\n",
+                    ec->http_address, ec->http_port, strerror(-ret));
+            exit(EXIT_FAILURE);
+        }
+    }
 }
 
 /**
@@ -331,45 +855,120 @@ void init(int argc, char *argv[], Ecounter_t *ec)
  */
 void fini(Ecounter_t *ec)
 {
+    workers_fini();
+
     for (int i = 0; i < INTERFACES_MAX; i++)
         ec->components[i].fini(&ec->components[i]);
+    topology_fini();
+
+    shm_fini();
+    snapshot_fini();
+    query_fini();
+    http_fini();
+    output_generation_fini();
+    history_fini();
+    rollup_fini();
+    journal_fini();
+    checkpoint_fini();
+
+    for (int i = 0; i < INTERFACES_MAX; i++)
+        component_free(&ec->components[i]);
+
+    free(ec->mock_watts);
+    close(ec->signals.fd);
+    sched_fini(&ec->sched);
 }
 
 /**
- * Catching SIGTERM for a graceful shutdown
+ * Publish the energy counters collected during the last scheduler round
  *
- * @param   signum[in]       Signal type
+ * @param   ec[in/out]     Main application structure
  */
-static void sigterm_handler(int signum)
+static void publish(Ecounter_t *ec)
 {
-    printf("Stopping ecounter\n");
-    fini(&ec_g);
-    exit(0);
+    const uint64_t tick = ec->sched.n_rounds;
+    bool is_updated = false;
+
+    for (int i = 0; i < INTERFACES_MAX; i++)
+        is_updated |= (ec->components[i].tick == tick);
+
+    /* Only the overhead evaluation ran during this round */
+    if (!is_updated)
+        return;
+
+    ec->generation++;
+
+    for (int i = 0; i < INTERFACES_MAX; i++)
+        if (ec->components[i].tick == tick)
+            ec->components[i].generation = ec->generation;
+
+    history_record(ec->components, INTERFACES_MAX, tick);
+    rollup_record(ec->components, INTERFACES_MAX, tick);
+    journal_record(ec->components, INTERFACES_MAX, tick);
+    checkpoint_record(ec->components, INTERFACES_MAX, tick);
+    shm_publish(ec->components, INTERFACES_MAX, tick, ec->generation);
+    snapshot_publish(ec->components, INTERFACES_MAX, ec->generation);
+    query_publish(ec->generation);
+    http_publish(ec->components, INTERFACES_MAX, ec->generation);
+
+    /* Last, so it is only seen once all the other outputs are updated */
+    output_generation_write(ec->generation);
 }
 
+/**
+ * Collect and publish the energy counters until SIGTERM. The signal is
+ * blocked and read through a signalfd by the event loop, so the daemon
+ * stops between two rounds and releases everything from here.
+ *
+ * @param   argc[in]    Amount of arguments
+ * @param   argv[in]    Array of arguments
+ */
 int main(int argc, char *argv[])
 {
+    /* Threads inherit the mask, SIGTERM is only read from the event loop */
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGTERM);
+    sigprocmask(SIG_BLOCK, &signals, NULL);
+
     init(argc, argv, &ec_g);
-    signal(SIGTERM, sigterm_handler);
 
     const bool is_verbose = ec_g.is_verbose;
 
-    printf("Starting ecounter -- Directory path: %s -- Interval: %u\n",
-           ec_g.dir_path, ec_g.interval);
+    printf("Starting ecounter -- Directory path: %s -- Interval: %lu ms\n",
+           ec_g.dir_path, ec_g.interval_ms);
 
-    while(true)
+    /* Nothing to collect, wait for termination */
+    if (ec_g.sched.n_tasks == 0)
     {
-        for (int i = 0; i < INTERFACES_MAX; i++)
-            ec_g.components[i].update(&ec_g.components[i]);
+        printf("No energy counter found\n");
+
+        int signum;
+        sigwait(&signals, &signum);
+    }
 
-        if (strlen(ec_g.power_cmd) > 0)
-            compute_overhead(&ec_g);
+    while(ec_g.sched.n_tasks > 0)
+    {
+        sched_run_once(&ec_g.sched);
+        if (ec_g.sched.is_stopped)
+            break;
+
+        /* The round is published once all its components are collected */
+        workers_wait();
+        publish(&ec_g);
 
         if (is_verbose)
-            printf("------------------------------ [Next data collection in %us]\n", ec_g.interval);
+        {
+            const uint64_t now = get_time_ns();
+            const uint64_t deadline = sched_next_deadline(&ec_g.sched);
 
-        sleep(ec_g.interval);
+            printf("------------------------------ [Next data collection in %lu ms]\n",
+                   (unsigned long)((deadline > now) ? (deadline - now) / NS_PER_MS : 0));
+        }
     }
 
+    printf("Stopping ecounter\n");
+    fini(&ec_g);
+
     return 0;
 }
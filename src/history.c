@@ -0,0 +1,311 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* EnergyCounter: Fetch and expose energy counters.
+* history.c: In-memory history of the samples of every unit. Every unit keeps
+*            a ring of its last samples, windows are found by binary search
+*            and the peak power by a max tree over the ring.
+*
+* URL       https://github.com/HewlettPackard/EnergyCounter
+******************************************************************************/
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "interface.h"
+#include "common.h"
+#include "history.h"
+
+static const Component_t *_history_components = NULL;
+static uint32_t           _history_n_components = 0;
+static History_t         *_histories[INTERFACES_MAX];     /* Indexed like the units */
+
+/**
+ * Physical position in the ring of the i-th oldest sample
+ */
+static inline uint32_t _history_pos(const History_t *history, const uint32_t i)
+{
+    return (history->head + history->capacity - history->n_samples + i) % history->capacity;
+}
+
+static inline const HistorySample_t *_history_sample(const History_t *history, const uint32_t i)
+{
+    return &history->samples[_history_pos(history, i)];
+}
+
+/**
+ * Find the oldest sample not older than a timestamp
+ *
+ * @return  Index of the sample (n_samples if none)
+ */
+static uint32_t _history_lower_bound(const History_t *history, const uint64_t timestamp)
+{
+    uint32_t low = 0;
+    uint32_t high = history->n_samples;
+
+    while (low < high)
+    {
+        const uint32_t mid = low + (high - low) / 2;
+
+        if (_history_sample(history, mid)->timestamp < timestamp)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return low;
+}
+
+/**
+ * Set the power of the interval ending at a position and update the max tree
+ */
+static void _history_set_peak(History_t *history, const uint32_t pos, const uint64_t power)
+{
+    uint32_t node = history->n_leaves + pos;
+
+    history->peaks[node] = power;
+    for (node /= 2; node > 0; node /= 2)
+        history->peaks[node] = MAX(history->peaks[2 * node], history->peaks[2 * node + 1]);
+}
+
+/**
+ * Highest power between two positions of the ring (both included, no wrap)
+ */
+static uint64_t _history_get_peak(const History_t *history, uint32_t first, uint32_t last)
+{
+    uint64_t peak = 0;
+
+    for (first += history->n_leaves, last += history->n_leaves + 1; first < last;
+         first /= 2, last /= 2)
+    {
+        /* MAX() evaluates its arguments twice */
+        if (first & 1)
+        {
+            peak = MAX(peak, history->peaks[first]);
+            first++;
+        }
+        if (last & 1)
+        {
+            last--;
+            peak = MAX(peak, history->peaks[last]);
+        }
+    }
+
+    return peak;
+}
+
+/**
+ * Allocate the history of every unit
+ *
+ * @param   components[in]   Array of all components
+ * @param   n_components[in] Amount of components
+ * @param   capacity[in]     Amount of samples kept per unit (0: disabled)
+ */
+void history_init(const Component_t *components, const uint32_t n_components,
+                  const uint32_t capacity)
+{
+    if (capacity == 0)
+        return;
+
+    if (capacity > HISTORY_CAPACITY_MAX)
+    {
+        fprintf(stderr, "Unable to keep more than %u samples per unit\n", HISTORY_CAPACITY_MAX);
+        exit(EXIT_FAILURE);
+    }
+
+    _history_components = components;
+    _history_n_components = MIN(n_components, INTERFACES_MAX);
+
+    uint32_t n_leaves = 1;
+    while (n_leaves < capacity)
+        n_leaves *= 2;
+
+    for (uint32_t i = 0; i < _history_n_components; i++)
+    {
+        if (components[i].n_siblings == 0)
+            continue;
+
+        _histories[i] = calloc(components[i].n_siblings, sizeof(History_t));
+        if (_histories[i] == NULL)
+        {
+            fprintf(stderr, "Unable to allocate the history of %s units\n", interface_str[i]);
+            exit(EXIT_FAILURE);
+        }
+
+        for (uint32_t j = 0; j < components[i].n_siblings; j++)
+        {
+            History_t *history = &_histories[i][j];
+
+            history->capacity = capacity;
+            history->n_leaves = n_leaves;
+            history->samples = calloc(capacity, sizeof(HistorySample_t));
+            history->peaks = calloc(2 * n_leaves, sizeof(uint64_t));
+            if (history->samples == NULL || history->peaks == NULL)
+            {
+                fprintf(stderr, "Unable to allocate the history of %s\n",
+                        components[i].siblings[j].name);
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+}
+
+/**
+ * Release the history of every unit
+ */
+void history_fini(void)
+{
+    for (uint32_t i = 0; i < _history_n_components; i++)
+    {
+        if (_histories[i] == NULL)
+            continue;
+
+        for (uint32_t j = 0; j < _history_components[i].n_siblings; j++)
+        {
+            free(_histories[i][j].samples);
+            free(_histories[i][j].peaks);
+        }
+
+        free(_histories[i]);
+        _histories[i] = NULL;
+    }
+
+    _history_components = NULL;
+    _history_n_components = 0;
+}
+
+/**
+ * Record the samples of the components collected during the last round
+ *
+ * @param   components[in]   Array of all components
+ * @param   n_components[in] Amount of components
+ * @param   tick[in]         Scheduler round to record
+ */
+void history_record(const Component_t *components, const uint32_t n_components,
+                    const uint64_t tick)
+{
+    if (_history_components == NULL)
+        return;
+
+    /* Histories only exist for the components known at init */
+    const uint32_t n_recorded = MIN(n_components, _history_n_components);
+
+    for (uint32_t i = 0; i < n_recorded; i++)
+    {
+        const Component_t *component = &components[i];
+
+        if (component->tick != tick)
+            continue;
+
+        for (uint32_t j = 0; j < component->n_siblings; j++)
+        {
+            const Counters_t *counters = &component->counters;
+            History_t *history = &_histories[i][j];
+            const HistorySample_t *last = (history->n_samples > 0) ?
+                                          _history_sample(history, history->n_samples - 1) : NULL;
+
+            /* The counter could not be read during this round */
+            if (last != NULL && counters->timestamp[j] <= last->timestamp)
+                continue;
+
+            const uint32_t pos = history->head;
+            uint64_t power = 0;
+
+            if (last != NULL && counters->energy_acc_uj[j] >= last->energy_acc_uj)
+                power = get_power_mw(counters->energy_acc_uj[j] - last->energy_acc_uj,
+                                     counters->timestamp[j] - last->timestamp);
+
+            history->samples[pos] = (HistorySample_t) {
+                .timestamp  = counters->timestamp[j],
+                .energy_raw = counters->energy_raw[j],
+                .energy_acc_uj = counters->energy_acc_uj[j],
+            };
+            _history_set_peak(history, pos, power);
+
+            history->head = (pos + 1) % history->capacity;
+            history->n_samples = MIN(history->n_samples + 1, history->capacity);
+        }
+    }
+}
+
+/**
+ * Compute the energy and the power of a unit between the first and the
+ * last samples recorded in a time range
+ *
+ * @param   name[in]      Name of the unit
+ * @param   t0[in]        Beginning of the range (monotonic, ns)
+ * @param   t1[in]        End of the range (monotonic, ns)
+ * @param   window[out]   Energy and power over the samples found
+ * @return  0 on success, -ENOENT for an unknown unit, -ENODATA if there is
+ *          less than 2 samples in the range
+ */
+int history_window(const char *name, const uint64_t t0, const uint64_t t1,
+                   HistoryWindow_t *window)
+{
+    const History_t *history = NULL;
+
+    for (uint32_t i = 0; i < _history_n_components && history == NULL; i++)
+        for (uint32_t j = 0; j < _history_components[i].n_siblings; j++)
+            if (strcmp(_history_components[i].siblings[j].name, name) == 0)
+            {
+                history = &_histories[i][j];
+                break;
+            }
+
+    if (history == NULL)
+        return -ENOENT;
+
+    /* Samples in [t0, t1] */
+    const uint32_t first = _history_lower_bound(history, t0);
+    const uint32_t end = (t1 == UINT64_MAX) ? history->n_samples :
+                         _history_lower_bound(history, t1 + 1);
+
+    if (end < first + 2)
+        return -ENODATA;
+
+    const uint32_t last = end - 1;
+    const HistorySample_t *from = _history_sample(history, first);
+    const HistorySample_t *to = _history_sample(history, last);
+
+    window->from = from->timestamp;
+    window->to = to->timestamp;
+    window->energy_uj = to->energy_acc_uj - from->energy_acc_uj;
+    window->average_power = get_power_mw(window->energy_uj, to->timestamp - from->timestamp);
+
+    /* Intervals ending after the first sample, split if the ring wraps */
+    const uint32_t pos_first = _history_pos(history, first + 1);
+    const uint32_t pos_last = _history_pos(history, last);
+
+    if (pos_first <= pos_last)
+        window->peak_power = _history_get_peak(history, pos_first, pos_last);
+    else
+    {
+        /* MAX() evaluates its arguments twice */
+        const uint64_t peak_end = _history_get_peak(history, pos_first, history->capacity - 1);
+        const uint64_t peak_start = _history_get_peak(history, 0, pos_last);
+
+        window->peak_power = MAX(peak_end, peak_start);
+    }
+
+    return 0;
+}
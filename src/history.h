@@ -0,0 +1,73 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* EnergyCounter: Fetch and expose energy counters.
+* history.h: In-memory history of the samples of every unit.
+*
+* URL       https://github.com/HewlettPackard/EnergyCounter
+******************************************************************************/
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdint.h>
+#include "interface.h"
+
+/* The capacity rounded to a power of two must fit in 32 bits */
+#define HISTORY_CAPACITY_MAX (1U << 31)
+
+typedef struct HistorySample
+{
+    uint64_t  timestamp;            /* Time of the read (monotonic, ns)      */
+    uint64_t  energy_raw;           /* Raw value of the counter              */
+    uint64_t  energy_acc_uj;        /* Accumulator in microjoules            */
+} HistorySample_t;
+
+typedef struct History
+{
+    HistorySample_t *samples;       /* Ring of the last samples              */
+    uint64_t        *peaks;         /* Max tree of the power (mW) of the
+                                       interval ending at each sample        */
+    uint32_t         capacity;      /* Amount of samples in the ring         */
+    uint32_t         n_leaves;      /* Capacity rounded to a power of two    */
+    uint32_t         head;          /* Next sample to overwrite              */
+    uint32_t         n_samples;
+} History_t;
+
+/* Energy and power of a unit between two recorded samples */
+typedef struct HistoryWindow
+{
+    uint64_t  from;                 /* Timestamp of the first sample (ns)    */
+    uint64_t  to;                   /* Timestamp of the last sample (ns)     */
+    uint64_t  energy_uj;            /* Energy between both samples (uJ)      */
+    uint64_t  average_power;        /* Average power (mW)                    */
+    uint64_t  peak_power;           /* Highest power of an interval (mW)     */
+} HistoryWindow_t;
+
+void history_init(const Component_t *components, const uint32_t n_components,
+                  const uint32_t capacity);
+void history_fini(void);
+void history_record(const Component_t *components, const uint32_t n_components,
+                    const uint64_t tick);
+int history_window(const char *name, const uint64_t t0, const uint64_t t1,
+                   HistoryWindow_t *window);
+
+#endif /* HISTORY_H */
@@ -0,0 +1,353 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* EnergyCounter: Fetch and expose energy counters.
+* http.c: Prometheus (OpenMetrics text) endpoint served from memory.
+*
+* URL       https://github.com/HewlettPackard/EnergyCounter
+******************************************************************************/
+
+
+#define _GNU_SOURCE     /* accept4() */
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include "interface.h"
+#include "common.h"
+#include "buffer.h"
+#include "scheduler.h"
+#include "snapshot.h"
+
+/* Prototypes used externaly */
+void http_publish(const Component_t *components, const uint32_t n_components,
+                  const uint64_t generation);
+
+#define HTTP_CLIENTS_MAX    64
+#define HTTP_REQUEST_MAX    2048         /* Longest request header          */
+
+typedef struct HttpClient
+{
+    Watch_t    watch;
+    bool       is_used;
+    char       request[HTTP_REQUEST_MAX];
+    uint32_t   request_len;
+    Buffer_t   pending;                 /* Response not sent yet           */
+    size_t     pending_off;
+} HttpClient_t;
+
+static const char _http_not_found[] =
+    "HTTP/1.1 404 Not Found\r\n"
+    "Content-Type: text/plain\r\n"
+    "Content-Length: 10\r\n"
+    "Connection: close\r\n"
+    "\r\n"
+    "Not Found\n";
+
+static const char _http_bad_request[] =
+    "HTTP/1.1 400 Bad Request\r\n"
+    "Content-Type: text/plain\r\n"
+    "Content-Length: 12\r\n"
+    "Connection: close\r\n"
+    "\r\n"
+    "Bad Request\n";
+
+static Scheduler_t  *_http_sched = NULL;
+static Watch_t       _http_listener = { .fd = -1 };
+static HttpClient_t  _http_clients[HTTP_CLIENTS_MAX];
+static Buffer_t      _http_responses[2];   /* Front (served) and back (rendered)   */
+static uint32_t      _http_front = 0;
+static Buffer_t      _http_body = { 0 };
+
+/**
+ * Disconnect a client and release its buffer
+ *
+ * @param   client[inout]  Client structure
+ */
+static void _http_client_close(HttpClient_t *client)
+{
+    sched_unwatch(_http_sched, &client->watch);
+    close(client->watch.fd);
+    buffer_free(&client->pending);
+    memset(client, 0, sizeof(HttpClient_t));
+}
+
+/**
+ * Send a response with a single write. A response which does not fit in
+ * the socket buffer is copied, so the front buffer can be replaced before
+ * the client reads the remainder.
+ *
+ * @param   client[inout]  Client structure
+ * @param   data[in]       Response
+ * @param   len[in]        Length of the response
+ * @return  true if the response was completely sent
+ */
+static bool _http_client_send(HttpClient_t *client, const char *data, const size_t len)
+{
+    ssize_t ret = send(client->watch.fd, data, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+    if (ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        return true;    /* Nothing more can be sent */
+
+    ret = (ret > 0) ? ret : 0;
+    if ((size_t)ret == len)
+        return true;
+
+    buffer_reset(&client->pending);
+    buffer_append(&client->pending, &data[ret], len - ret);
+    client->pending_off = 0;
+
+    return false;
+}
+
+/**
+ * Answer a complete request header
+ *
+ * @param   client[inout]  Client structure
+ * @return  true if the response was completely sent
+ */
+static bool _http_answer(HttpClient_t *client)
+{
+    const Buffer_t *response = &_http_responses[_http_front];
+    char *path = NULL;
+
+    client->request[client->request_len] = '\0';
+
+    if (strncmp(client->request, "GET ", 4) == 0)
+        path = &client->request[4];
+
+    if (path == NULL)
+        return _http_client_send(client, _http_bad_request, sizeof(_http_bad_request) - 1);
+
+    if (strncmp(path, "/metrics ", 9) != 0 && strncmp(path, "/ ", 2) != 0)
+        return _http_client_send(client, _http_not_found, sizeof(_http_not_found) - 1);
+
+    return _http_client_send(client, response->data, response->len);
+}
+
+/**
+ * Read the request of a client and send the pre-rendered response. The
+ * connection is closed once the response is sent.
+ *
+ * @param   arg[inout]   Client structure
+ * @param   events[in]   Epoll events
+ */
+static void _http_client_handle(void *arg, const uint32_t events)
+{
+    HttpClient_t *client = (HttpClient_t *)arg;
+
+    if (events & (EPOLLERR | EPOLLHUP))
+        goto close;
+
+    /* Remainder of a response */
+    if (events & EPOLLOUT)
+    {
+        const ssize_t ret = send(client->watch.fd, &client->pending.data[client->pending_off],
+                                 client->pending.len - client->pending_off,
+                                 MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (ret < 0 && errno != EAGAIN && errno != EINTR)
+            goto close;
+
+        client->pending_off += (ret > 0) ? ret : 0;
+        if (client->pending_off == client->pending.len)
+            goto close;
+
+        return;
+    }
+
+    const ssize_t ret = recv(client->watch.fd, &client->request[client->request_len],
+                             HTTP_REQUEST_MAX - 1 - client->request_len, MSG_DONTWAIT);
+    if (ret == 0)
+        goto close;
+    if (ret < 0)
+    {
+        if (errno == EAGAIN || errno == EINTR)
+            return;
+        goto close;
+    }
+
+    client->request_len += ret;
+    client->request[client->request_len] = '\0';
+
+    /* Wait for the end of the header */
+    if (strstr(client->request, "\r\n\r\n") == NULL && strstr(client->request, "\n\n") == NULL)
+    {
+        if (client->request_len == HTTP_REQUEST_MAX - 1)
+            goto close;
+        return;
+    }
+
+    if (_http_answer(client))
+        goto close;
+
+    if (sched_rewatch(_http_sched, &client->watch, EPOLLOUT) == 0)
+        return;
+
+close:
+    _http_client_close(client);
+}
+
+/**
+ * Accept the pending connections
+ *
+ * @param   arg[in]      Unused
+ * @param   events[in]   Epoll events
+ */
+static void _http_accept(void *arg, const uint32_t events)
+{
+    while (true)
+    {
+        const int fd = accept4(_http_listener.fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+            return;
+
+        HttpClient_t *client = NULL;
+        for (int i = 0; i < HTTP_CLIENTS_MAX && client == NULL; i++)
+            if (!_http_clients[i].is_used)
+                client = &_http_clients[i];
+
+        if (client == NULL)
+        {
+            close(fd);
+            continue;
+        }
+
+        client->is_used = true;
+        client->watch.fd = fd;
+        client->watch.handle = _http_client_handle;
+        client->watch.arg = client;
+
+        if (sched_watch(_http_sched, &client->watch, EPOLLIN) != 0)
+        {
+            close(fd);
+            memset(client, 0, sizeof(HttpClient_t));
+        }
+    }
+}
+
+/**
+ * Listen on a TCP port and serve the exposition from the event loop of the
+ * scheduler
+ *
+ * @param   address[in]      IPv4 address to bind
+ * @param   port[in]         TCP port
+ * @param   sched[inout]     Scheduler running the event loop
+ * @param   components[in]   Array of all components
+ * @param   n_components[in] Amount of components
+ * @return  0 on success, a negative error code otherwise
+ */
+int http_init(const char *address, const uint16_t port, Scheduler_t *sched,
+              const Component_t *components, const uint32_t n_components)
+{
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port) };
+    const int enable = 1;
+
+    if (inet_pton(AF_INET, address, &addr.sin_addr) != 1)
+        return -EINVAL;
+
+    _http_sched = sched;
+
+    _http_listener.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (_http_listener.fd < 0)
+        return -errno;
+
+    int ret = 0;
+    if (setsockopt(_http_listener.fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)) != 0 ||
+        bind(_http_listener.fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(_http_listener.fd, HTTP_CLIENTS_MAX) != 0)
+        ret = -errno;
+
+    _http_listener.handle = _http_accept;
+    if (ret == 0)
+        ret = sched_watch(sched, &_http_listener, EPOLLIN);
+
+    if (ret != 0)
+    {
+        close(_http_listener.fd);
+        _http_listener.fd = -1;
+        return ret;
+    }
+
+    /* Scrapes before the first collection get the units without energy */
+    http_publish(components, n_components, 0);
+
+    return 0;
+}
+
+/**
+ * Disconnect all clients and close the listening socket
+ */
+void http_fini(void)
+{
+    if (_http_listener.fd < 0)
+        return;
+
+    for (int i = 0; i < HTTP_CLIENTS_MAX; i++)
+        if (_http_clients[i].is_used)
+            _http_client_close(&_http_clients[i]);
+
+    sched_unwatch(_http_sched, &_http_listener);
+    close(_http_listener.fd);
+    _http_listener.fd = -1;
+
+    buffer_free(&_http_responses[0]);
+    buffer_free(&_http_responses[1]);
+    buffer_free(&_http_body);
+}
+
+/**
+ * Render the complete HTTP response in the back buffer, then make it the
+ * front one. Scrapes are served from the front buffer until the next
+ * publication.
+ *
+ * @param   components[in]   Array of all components
+ * @param   n_components[in] Amount of components
+ * @param   generation[in]   Generation of the publication
+ */
+void http_publish(const Component_t *components, const uint32_t n_components,
+                  const uint64_t generation)
+{
+    if (_http_listener.fd < 0)
+        return;
+
+    Buffer_t *response = &_http_responses[_http_front ^ 1];
+
+    buffer_reset(&_http_body);
+    snapshot_render(&_http_body, SNAPSHOT_PROM, components, n_components, generation,
+                    get_time_ns(), NULL);
+
+    buffer_reset(response);
+    buffer_append_str(response, "HTTP/1.1 200 OK\r\n"
+                                "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                                "Connection: close\r\n"
+                                "Content-Length: ");
+    buffer_append_u64(response, _http_body.len);
+    buffer_append_str(response, "\r\n\r\n");
+    buffer_append(response, _http_body.data, _http_body.len);
+
+    _http_front ^= 1;
+}
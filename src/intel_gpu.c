@@ -33,6 +33,7 @@
 #include <string.h>
 #include <linux/limits.h>
 #include "interface.h"
+#include "output.h"
 #include "common.h"
 
 /* Prototypes used externaly */
@@ -53,17 +54,17 @@ zes_device_handle_t *_zes_devices       = NULL;
 zes_pwr_handle_t    *_zes_power_domains = NULL;
 zes_pwr_handle_t    *_zes_power         = NULL;
 uint32_t _zes_power_domains_max = 0;
-#endif /* INTEL_GPU */
 
 /**
- * Write latest counter value in the destination file for a given GPU
+ * Stage the latest counter value of a given GPU
  *
- * @param   dev[in]  Unit structure for the GPU
+ * @param   gpus[inout]  GPU structure
+ * @param   i[in]        Index of the GPU
  */
-static void _intel_device_update_files(Unit_t *dev)
+static void _intel_device_fetch_energy(Component_t *gpus, const uint32_t i)
 {
-#ifdef INTEL_GPU
-    uint64_t last_energy_raw = dev->energy_raw;
+    const Unit_t *dev = &gpus->siblings[i];
+    Counters_t *counters = &gpus->counters;
 
     zes_power_energy_counter_t energy_counter;
     ze_result_t ret = zesPowerGetEnergyCounter(_zes_power[dev->id], &energy_counter);
@@ -73,34 +74,23 @@ static void _intel_device_update_files(Unit_t *dev)
         zeDriverGetLastErrorDescription(_zes_drivers[0], &estring);
         fprintf(stderr, "Unable to retrieve energy counter from Intel device %u: %s\n", dev->id, estring);
     }
-    dev->energy_raw = energy_counter.energy;
+    counters->energy_raw_next[i] = energy_counter.energy;
+    counters->timestamp[i] = get_time_ns();
 
     /* First iteration */
-    if (!last_energy_raw)
-        return;
+    if (counters->energy_raw[i] == 0)
+        counters->energy_raw[i] = counters->energy_raw_next[i];
 
     /* XXX: This type should be large enough to never overflow */
-    assert(dev->energy_raw >= last_energy_raw);
-
-    dev->energy_interval = (dev->energy_raw - last_energy_raw) / 1E6;
-
-    /* TODO: Use a better model like the one for AMD MI250Xs based on GPU usage */
-    if (dev->model == MAX1550) /* Half for each tile */
-        dev->energy_interval /= 2;
-
-    dev->energy_acc += dev->energy_interval;
-
-    /* Updating the file */
-    fprintf(dev->energy_fd, "%lu Joules", dev->energy_acc);
-    rewind(dev->energy_fd); /* Flush buffer and prepare for overwriting next value */
-#endif /* INTEL_GPU */
+    assert(counters->energy_raw_next[i] >= counters->energy_raw[i]);
 }
+#endif /* INTEL_GPU */
 
 /**
  * Initialize this GPU module
  *
  * @param   gpus[out]       GPU structure to initialize all GPUs
- * @param   dest_dir[in]    Directory contaning the files with the energy counters
+ * @param   dest_dir[in]    Directory contaning the files with the energy counters (NULL if disabled)
  * @param   is_verbose[in]  Whether the verbose mode should be enabled
  * @param   is_disabled[in] Whether the module should be disabled
  */
@@ -171,12 +161,15 @@ void intel_gpu_init(Component_t *gpus, const char *dest_dir, const bool is_verbo
     if (count == 0)
         goto exit;
 
-    gpus->n_siblings = count;
+    if (component_alloc(gpus, count) != 0)
+    {
+        ret = ZE_RESULT_ERROR_OUT_OF_HOST_MEMORY;
+        goto exit;
+    }
+
     if (is_verbose)
         printf("%u Intel GPU devices found\n", gpus->n_siblings);
 
-    assert(gpus->n_siblings < N_SIBLINGS_MAX);
-
     _zes_devices = malloc(count * sizeof(zes_device_handle_t));
     if (_zes_devices == NULL)
     {
@@ -267,6 +260,10 @@ void intel_gpu_init(Component_t *gpus, const char *dest_dir, const bool is_verbo
         if (is_verbose && dev->model == MAX1550)
             printf("Intel Max 1550 found, enabling split (50/50) energy consumption across tiles\n");
 
+        /* The counter is in microjoules */
+        /* TODO: Use a better model like the one for AMD MI250Xs based on GPU usage */
+        gpus->counters.energy_scale[i] = energy_scale((dev->model == MAX1550) ? 0.5 : 1.0);
+
         /* Retrieve power domains */
         uint32_t power_count = _zes_power_domains_max;
         ret = zesDeviceEnumPowerDomains(zes_dev, &power_count, &_zes_power_domains[i * _zes_power_domains_max]);
@@ -301,13 +298,10 @@ void intel_gpu_init(Component_t *gpus, const char *dest_dir, const bool is_verbo
             }
         }
 
-        char output_path[PATH_MAX];
         /* Opening normalized file (Joules) */
-        snprintf(output_path, sizeof(output_path), "%s/gpu_%2.2lx_%u_energy", dest_dir, dev->bus_id, dev->id);
-        dev->energy_fd = fopen(output_path, "w");
-        if (!dev->energy_fd)
+        snprintf(dev->name, sizeof(dev->name), "gpu_%2.2lx_%u", dev->bus_id, dev->id);
+        if (output_open(dev, dest_dir) != 0)
         {
-            fprintf(stderr, "Failed to open output file: %s\n", output_path);
             ret = ZE_RESULT_ERROR_UNKNOWN;
             goto exit;
         }
@@ -345,7 +339,7 @@ void intel_gpu_fini(Component_t *gpus)
     for (uint32_t i = 0; i < gpus->n_siblings; ++i)
     {
         Unit_t *dev = &gpus->siblings[i];
-        fclose(dev->energy_fd);
+        output_close(dev);
     }
 
     free(_zes_power);
@@ -364,13 +358,23 @@ void intel_gpu_update(Component_t *gpus)
 {
     const bool is_verbose = gpus->is_verbose;
 
+#ifdef INTEL_GPU
+    for (uint32_t i = 0; i < gpus->n_siblings; ++i)
+        _intel_device_fetch_energy(gpus, i);
+
+    counters_accumulate(&gpus->counters, gpus->n_siblings, UINT64_MAX);
+#endif /* INTEL_GPU */
+
     for (uint32_t i = 0; i < gpus->n_siblings; ++i)
     {
         Unit_t *dev = &gpus->siblings[i];
-        _intel_device_update_files(dev);
+        const Counters_t *counters = &gpus->counters;
+
+        /* Updating the file */
+        output_write(dev, counters->energy_acc[i]);
 
         if (is_verbose)
-            printf("Intel GPU %u (0x%2.2lx): %lu J (accumulator: %lu J, raw: %lu)\n",
-                   dev->id, dev->bus_id, dev->energy_interval, dev->energy_acc, dev->energy_raw);
+            printf("Intel GPU %u (0x%2.2lx): %lu J (accumulator: %lu J, raw: %lu)\n", dev->id, dev->bus_id,
+                   counters->energy_interval[i], counters->energy_acc[i], counters->energy_raw[i]);
     }
 }
@@ -0,0 +1,145 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* EnergyCounter: Fetch and expose energy counters.
+* interface.c: Storage of the units of a component.
+*
+* URL       https://github.com/HewlettPackard/EnergyCounter
+******************************************************************************/
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "interface.h"
+
+#define COUNTERS_ARRAYS (sizeof(Counters_t) / sizeof(uint64_t *))
+
+/**
+ * Allocate the units of a component. The counters are allocated in a single
+ * block, one array after the other.
+ *
+ * @param   component[inout]  Component structure
+ * @param   n_siblings[in]    Amount of units
+ * @return  0 on success, a negative error code otherwise
+ */
+int component_alloc(Component_t *component, const uint32_t n_siblings)
+{
+    component->n_siblings = 0;
+
+    if (n_siblings == 0)
+        return 0;
+
+    Unit_t *siblings = calloc(n_siblings, sizeof(Unit_t));
+    uint64_t *block = calloc((size_t)n_siblings * COUNTERS_ARRAYS, sizeof(uint64_t));
+    if (siblings == NULL || block == NULL)
+    {
+        fprintf(stderr, "Unable to allocate %u units\n", n_siblings);
+        free(siblings);
+        free(block);
+        return -ENOMEM;
+    }
+
+    Counters_t *counters = &component->counters;
+    counters->timestamp          = &block[0 * n_siblings];
+    counters->energy_raw         = &block[1 * n_siblings];
+    counters->energy_raw_next    = &block[2 * n_siblings];
+    counters->energy_scale       = &block[3 * n_siblings];
+    counters->energy_frac        = &block[4 * n_siblings];
+    counters->energy_acc         = &block[5 * n_siblings];
+    counters->energy_interval    = &block[6 * n_siblings];
+    counters->energy_acc_uj      = &block[7 * n_siblings];
+    counters->energy_interval_uj = &block[8 * n_siblings];
+
+    component->siblings = siblings;
+    component->n_siblings = n_siblings;
+
+    return 0;
+}
+
+/**
+ * Release the units of a component
+ *
+ * @param   component[inout]  Component structure
+ */
+void component_free(Component_t *component)
+{
+    /* The timestamps are the first array of the block */
+    free(component->counters.timestamp);
+    free(component->siblings);
+
+    component->counters = (Counters_t){ 0 };
+    component->siblings = NULL;
+    component->n_siblings = 0;
+}
+
+/**
+ * Delta, scaling and accumulation of a batch of readings. The arrays never
+ * overlap, restrict lets the compiler vectorize the loop without aliasing
+ * checks.
+ */
+static void _counters_accumulate_uj(const uint32_t n, const uint64_t wrap_mask,
+                                    uint64_t *restrict energy_raw,
+                                    const uint64_t *restrict energy_raw_next,
+                                    const uint64_t *restrict energy_scale,
+                                    uint64_t *restrict energy_frac,
+                                    uint64_t *restrict energy_acc_uj,
+                                    uint64_t *restrict energy_interval_uj)
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        /* Unsigned arithmetic handles the wraparound of the counter */
+        const uint64_t delta = (energy_raw_next[i] - energy_raw[i]) & wrap_mask;
+        const uint64_t energy = delta * energy_scale[i] + energy_frac[i];
+
+        energy_raw[i] = energy_raw_next[i];
+        energy_frac[i] = energy & ((1ULL << SCALE_SHIFT) - 1);
+        energy_interval_uj[i] = energy >> SCALE_SHIFT;
+        energy_acc_uj[i] += energy >> SCALE_SHIFT;
+    }
+}
+
+/**
+ * Account for the readings of the current collection of all the units of a
+ * component: delta with the last reading modulo the width of the hardware
+ * counters, scaling to microjoules and accumulation, for all units at once.
+ * A unit whose counter could not be read must have its last reading as its
+ * next one.
+ *
+ * @param   counters[inout]  Counters of the component, energy_raw_next set
+ * @param   n_siblings[in]   Amount of units
+ * @param   wrap_mask[in]    Mask of the bits of the hardware counters (e.g. UINT32_MAX)
+ */
+void counters_accumulate(Counters_t *counters, const uint32_t n_siblings, const uint64_t wrap_mask)
+{
+    _counters_accumulate_uj(n_siblings, wrap_mask, counters->energy_raw, counters->energy_raw_next,
+                            counters->energy_scale, counters->energy_frac,
+                            counters->energy_acc_uj, counters->energy_interval_uj);
+
+    /* The values in Joules are derived from the accumulators */
+    for (uint32_t i = 0; i < n_siblings; i++)
+    {
+        const uint64_t last_energy_acc = counters->energy_acc[i];
+
+        counters->energy_acc[i] = counters->energy_acc_uj[i] / UJ_PER_J;
+        counters->energy_interval[i] = counters->energy_acc[i] - last_energy_acc;
+    }
+}
@@ -33,18 +33,31 @@
 #include <unistd.h>
 #include <stdbool.h>
 
-#define N_SIBLINGS_MAX 16
+#define UJ_PER_J       1000000ULL
+#define SCALE_SHIFT    20           /* Fractional bits of the energy scales */
 
 enum interface {
     AMD_GPUS,
     INTEL_GPUS,
     NVIDIA_GPUS,
     CPUS,
+    CPU_CORES,
     DRAMS,
     MOCKS,
     INTERFACES_MAX
 };
 
+static const char * const interface_str[] =
+{
+    [AMD_GPUS]    = "amd_gpu",
+    [INTEL_GPUS]  = "intel_gpu",
+    [NVIDIA_GPUS] = "nvidia_gpu",
+    [CPUS]        = "cpu",
+    [CPU_CORES]   = "cpu_core",
+    [DRAMS]       = "dram",
+    [MOCKS]       = "mock",
+};
+
 enum vendor {
     AMD,
     INTEL,
@@ -77,33 +90,83 @@ static const char * const type_str[] =
     [TYPE_UNKNOWN] = "unknown",
 };
 
+/* Description of a unit, only read when a unit is discovered or reported */
 typedef struct Unit
 {
-    uint64_t     timestamp;
     uint64_t     bus_id;
-    double       energy_resolution;
-    uint64_t     energy_raw;
-    uint64_t     energy_acc;           /* Energy accumulator in Joules */
-    uint64_t     energy_interval;      /* Energy during last interval in Joules */
-    FILE        *energy_fd;
+    int          energy_fd;            /* Output file, -1 if disabled */
+    uint32_t     energy_len;           /* Length of the last value written */
     uint32_t     id;
     uint32_t     model;
     uint32_t     busy_percent;
     uint32_t     fixed_watts;
     char         serial[64];
+    char         name[32];             /* Name of the unit, prefix of its output file */
     struct Unit *peer;
 } Unit_t;
 
+/* Values updated on every collection, one array per value indexed like the
+ * units, so a collection walks contiguous memory whatever the amount of units */
+typedef struct Counters
+{
+    uint64_t    *timestamp;
+    uint64_t    *energy_raw;
+    uint64_t    *energy_raw_next;      /* Reading of the current collection, not accounted yet */
+    uint64_t    *energy_scale;         /* Microjoules per raw unit, SCALE_SHIFT fractional bits */
+    uint64_t    *energy_frac;          /* Fraction of microjoule left by the last interval */
+    uint64_t    *energy_acc;           /* Energy accumulator in Joules */
+    uint64_t    *energy_interval;      /* Energy during last interval in Joules */
+    uint64_t    *energy_acc_uj;        /* Energy accumulator in microjoules */
+    uint64_t    *energy_interval_uj;   /* Energy during last interval in microjoules */
+} Counters_t;
+
 typedef struct Component
 {
-    Unit_t    siblings[N_SIBLINGS_MAX];
-    int       type;
-    int       vendor;
-    uint32_t  n_siblings;
-    bool      is_verbose;
-    void      (*fini)(struct Component*);
-    void      (*update)(struct Component*);
+    Unit_t     *siblings;
+    Counters_t  counters;
+    int         type;
+    int         vendor;
+    uint32_t    n_siblings;
+    uint64_t    tick;               /* Scheduler round of the current collection */
+    uint64_t    generation;         /* Last publication including the component  */
+    bool        is_verbose;
+    void        (*fini)(struct Component*);
+    void        (*update)(struct Component*);
 } Component_t;
 
+int component_alloc(Component_t *component, const uint32_t n_siblings);
+void component_free(Component_t *component);
+void counters_accumulate(Counters_t *counters, const uint32_t n_siblings, const uint64_t wrap_mask);
+
+/**
+ * Convert a resolution to an energy scale
+ *
+ * @param   uj_per_raw[in]  Microjoules per raw unit of the counter
+ * @return  Energy scale with SCALE_SHIFT fractional bits
+ */
+static inline uint64_t energy_scale(const double uj_per_raw)
+{
+    return (uint64_t)(uj_per_raw * (1ULL << SCALE_SHIFT) + 0.5);
+}
+
+/**
+ * Account for the energy of the last interval of a unit. Energy is
+ * accumulated in microjoules, the values in Joules are derived from the
+ * accumulator so truncation never accumulates.
+ *
+ * @param   counters[inout]  Counters of the component
+ * @param   i[in]            Index of the unit
+ * @param   energy_uj[in]    Energy of the last interval in microjoules
+ */
+static inline void unit_add_energy(Counters_t *counters, const uint32_t i, const uint64_t energy_uj)
+{
+    const uint64_t last_energy_acc = counters->energy_acc[i];
+
+    counters->energy_interval_uj[i] = energy_uj;
+    counters->energy_acc_uj[i] += energy_uj;
+    counters->energy_acc[i] = counters->energy_acc_uj[i] / UJ_PER_J;
+    counters->energy_interval[i] = counters->energy_acc[i] - last_energy_acc;
+}
+
 #endif /* INTERFACE_H */
 
@@ -0,0 +1,279 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* EnergyCounter: Fetch and expose energy counters.
+* journal.c: Compressed append-only journal of every raw counter read.
+*            Records are batched in blocks written with a single write and
+*            segments rotate by size.
+*
+* URL       https://github.com/HewlettPackard/EnergyCounter
+******************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/limits.h>
+#include "interface.h"
+#include "common.h"
+#include "journal.h"
+
+#define JOURNAL_BATCH_MAX     256                   /* Records per block                */
+#define JOURNAL_RECORD_MAX    (4 * JOURNAL_VARINT_MAX)
+#define JOURNAL_FLUSH_NS      (60 * NS_PER_S)       /* Oldest record kept in memory     */
+#define JOURNAL_SEGMENT_SIZE  (16 << 20)            /* Size before rotating a segment   */
+#define JOURNAL_SEGMENTS_MAX  16                    /* Segments kept by this instance   */
+
+static bool            _journal_is_enabled = false;
+static char            _journal_dir[PATH_MAX];
+static uint32_t        _journal_n_units = 0;
+static uint8_t        *_journal_header = NULL;     /* Segment header, units included   */
+static JournalUnit_t  *_journal_units = NULL;      /* Units, right after the header    */
+static JournalState_t *_journal_states = NULL;
+
+/* Block being filled, the header is written in front of the payload */
+static uint8_t         _journal_block[sizeof(JournalBlock_t) + JOURNAL_BATCH_MAX * JOURNAL_RECORD_MAX];
+static uint32_t        _journal_block_len = 0;
+static uint32_t        _journal_n_records = 0;
+static uint64_t        _journal_block_start = 0;    /* Time of the first record (ns)    */
+
+static int             _journal_fd = -1;
+static uint64_t        _journal_segment_size = 0;
+static char            _journal_segments[JOURNAL_SEGMENTS_MAX][PATH_MAX];
+static uint32_t        _journal_n_segments = 0;
+
+/**
+ * Write a buffer in the current segment
+ *
+ * @return  0 on success, a negative error code otherwise
+ */
+static int _journal_write(const void *buf, const uint32_t len)
+{
+    const ssize_t ret = write(_journal_fd, buf, len);
+
+    if (ret < 0)
+        return -errno;
+
+    return (ret == len) ? 0 : -EIO;
+}
+
+/**
+ * Close the current segment and start a new one, the oldest segment of
+ * this instance is removed once JOURNAL_SEGMENTS_MAX are written
+ *
+ * @return  0 on success, a negative error code otherwise
+ */
+static int _journal_rotate(void)
+{
+    struct timespec realtime;
+    const uint32_t header_size = sizeof(JournalHeader_t) + _journal_n_units * sizeof(JournalUnit_t);
+
+    if (_journal_fd >= 0)
+        close(_journal_fd);
+    _journal_fd = -1;
+
+    char *path = _journal_segments[_journal_n_segments % JOURNAL_SEGMENTS_MAX];
+    if (_journal_n_segments >= JOURNAL_SEGMENTS_MAX)
+        unlink(path);
+
+    clock_gettime(CLOCK_REALTIME, &realtime);
+    const uint64_t now = realtime.tv_sec * NS_PER_S + realtime.tv_nsec;
+
+    if (snprintf(path, PATH_MAX, "%s/journal-%020lu.ecj", _journal_dir, now) >= PATH_MAX)
+    {
+        /* Never unlink a truncated path when the slot is reused */
+        path[0] = '\0';
+        return -ENAMETOOLONG;
+    }
+    _journal_n_segments++;
+
+    _journal_fd = open(path, O_WRONLY | O_CREAT | O_EXCL | O_APPEND | O_CLOEXEC, 0644);
+    if (_journal_fd < 0)
+        return -errno;
+
+    *(JournalHeader_t *)_journal_header = (JournalHeader_t) {
+        .magic     = JOURNAL_MAGIC,
+        .version   = JOURNAL_VERSION,
+        .n_units   = _journal_n_units,
+        .unit_size = sizeof(JournalUnit_t),
+        .realtime  = now,
+        .monotonic = get_time_ns(),
+    };
+
+    _journal_segment_size = header_size;
+
+    return _journal_write(_journal_header, header_size);
+}
+
+/**
+ * Write the current block with a single write and start a new one
+ */
+static void _journal_flush(void)
+{
+    if (_journal_n_records == 0)
+        return;
+
+    *(JournalBlock_t *)_journal_block = (JournalBlock_t) {
+        .magic     = JOURNAL_BLOCK_MAGIC,
+        .len       = _journal_block_len - sizeof(JournalBlock_t),
+        .n_records = _journal_n_records,
+    };
+
+    int ret = 0;
+    if (_journal_fd < 0 || _journal_segment_size + _journal_block_len > JOURNAL_SEGMENT_SIZE)
+        ret = _journal_rotate();
+
+    if (ret == 0)
+        ret = _journal_write(_journal_block, _journal_block_len);
+
+    if (ret != 0)
+        fprintf(stderr, "Failed to write %u samples in the journal: %s\n",
+                _journal_n_records, strerror(-ret));
+    else
+        _journal_segment_size += _journal_block_len;
+
+    /* Blocks are decoded on their own */
+    memset(_journal_states, 0, _journal_n_units * sizeof(JournalState_t));
+    _journal_block_len = sizeof(JournalBlock_t);
+    _journal_n_records = 0;
+}
+
+/**
+ * Enable the journal and describe every unit
+ *
+ * @param   dir_path[in]     Directory of the segments
+ * @param   components[in]   Array of all components
+ * @param   n_components[in] Amount of components
+ * @return  0 on success, a negative error code otherwise
+ */
+int journal_init(const char *dir_path, const Component_t *components, const uint32_t n_components)
+{
+    strncpy(_journal_dir, dir_path, PATH_MAX - 1);
+    _journal_n_units = 0;
+
+    uint32_t n_units = 0;
+    for (uint32_t i = 0; i < n_components; i++)
+        n_units += components[i].n_siblings;
+
+    _journal_header = calloc(1, sizeof(JournalHeader_t) + n_units * sizeof(JournalUnit_t));
+    _journal_states = calloc(MAX(n_units, 1), sizeof(JournalState_t));
+    if (_journal_header == NULL || _journal_states == NULL)
+        return -ENOMEM;
+
+    _journal_units = (JournalUnit_t *)&_journal_header[sizeof(JournalHeader_t)];
+
+    for (uint32_t i = 0; i < n_components; i++)
+    {
+        const Component_t *component = &components[i];
+
+        for (uint32_t j = 0; j < component->n_siblings; j++)
+        {
+            JournalUnit_t *unit = &_journal_units[_journal_n_units++];
+
+            strncpy(unit->name, component->siblings[j].name, sizeof(unit->name) - 1);
+            unit->type = component->type;
+            unit->vendor = component->vendor;
+            unit->bus_id = component->siblings[j].bus_id;
+        }
+    }
+
+    _journal_block_len = sizeof(JournalBlock_t);
+    _journal_n_records = 0;
+
+    int ret = _journal_rotate();
+    if (ret != 0)
+        return ret;
+
+    _journal_is_enabled = true;
+
+    return 0;
+}
+
+/**
+ * Write the pending samples and close the current segment
+ */
+void journal_fini(void)
+{
+    if (!_journal_is_enabled)
+        return;
+
+    _journal_flush();
+
+    close(_journal_fd);
+    _journal_fd = -1;
+    _journal_is_enabled = false;
+
+    free(_journal_header);
+    free(_journal_states);
+    _journal_header = NULL;
+    _journal_units = NULL;
+    _journal_states = NULL;
+}
+
+/**
+ * Append the samples of the components collected during the last round,
+ * the block is written once full or when its oldest sample gets too old
+ *
+ * @param   components[in]   Array of all components
+ * @param   n_components[in] Amount of components
+ * @param   tick[in]         Scheduler round to record
+ */
+void journal_record(const Component_t *components, const uint32_t n_components,
+                    const uint64_t tick)
+{
+    if (!_journal_is_enabled)
+        return;
+
+    uint32_t k = 0;
+    for (uint32_t i = 0; i < n_components; i++)
+    {
+        const Component_t *component = &components[i];
+
+        if (component->tick != tick)
+        {
+            k += component->n_siblings;
+            continue;
+        }
+
+        for (uint32_t j = 0; j < component->n_siblings; j++, k++)
+        {
+            const Counters_t *counters = &component->counters;
+
+            if (_journal_n_records == JOURNAL_BATCH_MAX)
+                _journal_flush();
+
+            if (_journal_n_records == 0)
+                _journal_block_start = counters->timestamp[j];
+
+            _journal_block_len += journal_encode(&_journal_block[_journal_block_len],
+                                                 &_journal_states[k], k, counters->timestamp[j],
+                                                 counters->energy_raw[j], counters->energy_interval_uj[j]);
+            _journal_n_records++;
+        }
+    }
+
+    if (_journal_n_records > 0 && get_time_ns() - _journal_block_start >= JOURNAL_FLUSH_NS)
+        _journal_flush();
+}
@@ -0,0 +1,211 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* EnergyCounter: Fetch and expose energy counters.
+* journal.h: On-disk format of the compressed journal of raw samples, shared
+*            by the daemon and the ecounter-dump reader.
+*
+* URL       https://github.com/HewlettPackard/EnergyCounter
+******************************************************************************/
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdint.h>
+
+/*
+ * A journal is a set of segment files (journal-<realtime ns>.ecj). A
+ * segment starts with a header describing the units, followed by blocks
+ * written with a single write each. A block can be decoded on its own: the
+ * state of the encoders is reset at the beginning of every block, so a torn
+ * block at the end of a segment only loses its own samples.
+ *
+ * A record is a sequence of varints:
+ *   - index of the unit in the header
+ *   - delta-of-delta of the timestamp of the unit (zigzag)
+ *   - energy_raw XOR the previous energy_raw of the unit
+ *   - energy of the interval (uJ, J in version 1)
+ */
+
+#define JOURNAL_MAGIC          0x4a434345  /* "ECCJ" */
+#define JOURNAL_BLOCK_MAGIC    0x4b4c4245  /* "EBLK" */
+#define JOURNAL_VERSION        2
+#define JOURNAL_BLOCK_MAX      (1 << 20)   /* Largest payload of a block */
+#define JOURNAL_VARINT_MAX     10          /* Bytes of a 64-bit varint   */
+
+typedef struct JournalHeader
+{
+    uint32_t  magic;
+    uint32_t  version;
+    uint32_t  n_units;
+    uint32_t  unit_size;            /* sizeof(JournalUnit_t)                 */
+    uint64_t  realtime;             /* Creation time (realtime clock, ns)    */
+    uint64_t  monotonic;            /* Creation time (monotonic clock, ns)   */
+} JournalHeader_t;
+
+typedef struct JournalUnit
+{
+    char      name[32];
+    uint32_t  type;                 /* enum type in interface.h              */
+    uint32_t  vendor;               /* enum vendor in interface.h            */
+    uint64_t  bus_id;
+} JournalUnit_t;
+
+typedef struct JournalBlock
+{
+    uint32_t  magic;
+    uint32_t  len;                  /* Size of the payload                   */
+    uint32_t  n_records;
+    uint32_t  reserved;
+} JournalBlock_t;
+
+/* State of the encoder or decoder of a unit within a block */
+typedef struct JournalState
+{
+    uint64_t  timestamp;
+    uint64_t  delta;
+    uint64_t  energy_raw;
+} JournalState_t;
+
+/**
+ * Encode a varint (7 bits per byte, least significant first)
+ *
+ * @return  Amount of bytes written, JOURNAL_VARINT_MAX at most
+ */
+static inline uint32_t journal_put_varint(uint8_t *buf, uint64_t value)
+{
+    uint32_t n = 0;
+
+    while (value >= 0x80)
+    {
+        buf[n++] = (uint8_t)value | 0x80;
+        value >>= 7;
+    }
+    buf[n++] = (uint8_t)value;
+
+    return n;
+}
+
+/**
+ * Decode a varint
+ *
+ * @return  Amount of bytes read, 0 if the buffer ends before the varint
+ */
+static inline uint32_t journal_get_varint(const uint8_t *buf, const uint32_t len, uint64_t *value)
+{
+    *value = 0;
+
+    for (uint32_t n = 0; n < len && n < JOURNAL_VARINT_MAX; n++)
+    {
+        *value |= (uint64_t)(buf[n] & 0x7f) << (7 * n);
+        if ((buf[n] & 0x80) == 0)
+            return n + 1;
+    }
+
+    return 0;
+}
+
+static inline uint64_t journal_zigzag(const int64_t value)
+{
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static inline int64_t journal_unzigzag(const uint64_t value)
+{
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+/**
+ * Encode a record, at most 4 * JOURNAL_VARINT_MAX bytes
+ *
+ * @param   buf[out]       Destination
+ * @param   state[inout]   State of the unit in the current block
+ * @param   unit[in]       Index of the unit
+ * @param   timestamp[in]  Time of the read (monotonic, ns)
+ * @param   energy_raw[in] Raw value of the counter
+ * @param   energy[in]     Energy of the interval (uJ)
+ * @return  Amount of bytes written
+ */
+static inline uint32_t journal_encode(uint8_t *buf, JournalState_t *state, const uint32_t unit,
+                                      const uint64_t timestamp, const uint64_t energy_raw,
+                                      const uint64_t energy)
+{
+    const uint64_t delta = timestamp - state->timestamp;
+    uint32_t n = 0;
+
+    n += journal_put_varint(&buf[n], unit);
+    n += journal_put_varint(&buf[n], journal_zigzag((int64_t)(delta - state->delta)));
+    n += journal_put_varint(&buf[n], energy_raw ^ state->energy_raw);
+    n += journal_put_varint(&buf[n], energy);
+
+    state->timestamp = timestamp;
+    state->delta = delta;
+    state->energy_raw = energy_raw;
+
+    return n;
+}
+
+/**
+ * Decode a record
+ *
+ * @param   buf[in]         Source
+ * @param   len[in]         Bytes left in the block
+ * @param   states[inout]   States of all units in the current block
+ * @param   n_units[in]     Amount of units
+ * @param   unit[out]       Index of the unit
+ * @param   timestamp[out]  Time of the read (monotonic, ns)
+ * @param   energy_raw[out] Raw value of the counter
+ * @param   energy[out]     Energy of the interval (uJ)
+ * @return  Amount of bytes read, 0 if the record is invalid
+ */
+static inline uint32_t journal_decode(const uint8_t *buf, const uint32_t len,
+                                      JournalState_t *states, const uint32_t n_units,
+                                      uint32_t *unit, uint64_t *timestamp,
+                                      uint64_t *energy_raw, uint64_t *energy)
+{
+    uint64_t values[4];
+    uint32_t n = 0;
+
+    for (int i = 0; i < 4; i++)
+    {
+        const uint32_t ret = journal_get_varint(&buf[n], len - n, &values[i]);
+        if (ret == 0)
+            return 0;
+        n += ret;
+    }
+
+    if (values[0] >= n_units)
+        return 0;
+
+    JournalState_t *state = &states[values[0]];
+    state->delta += (uint64_t)journal_unzigzag(values[1]);
+    state->timestamp += state->delta;
+    state->energy_raw ^= values[2];
+
+    *unit = values[0];
+    *timestamp = state->timestamp;
+    *energy_raw = state->energy_raw;
+    *energy = values[3];
+
+    return n;
+}
+
+#endif /* JOURNAL_H */
@@ -34,6 +34,7 @@
 #include <errno.h>
 #include <linux/limits.h>
 #include "interface.h"
+#include "output.h"
 #include "common.h"
 
 /* Prototypes used externaly */
@@ -43,57 +44,56 @@ void mock_update(Component_t *mocks);
 /**
  * Write latest counter value in the destination file for a given mock unit
  *
- * @param   mock[in]  Mock unit structure
+ * @param   mocks[inout]  Mock structure
+ * @param   i[in]         Index of the mock unit
  */
-static void _mock_update_files(Unit_t *mock)
+static void _mock_update_files(Component_t *mocks, const uint32_t i)
 {
-    mock->energy_acc += mock->energy_interval;
+    Counters_t *counters = &mocks->counters;
+
+    unit_add_energy(counters, i, counters->energy_interval_uj[i]);
+    counters->timestamp[i] = get_time_ns();
 
     /* Updating the file */
-    fprintf(mock->energy_fd, "%lu Joules", mock->energy_acc);
-    rewind(mock->energy_fd); /* Flush buffer and prepare for overwriting next value */
+    output_write(&mocks->siblings[i], counters->energy_acc[i]);
 }
 
 /**
  * Initialize this mock module
  *
  * @param   mocks[out]     Mock structure to initialize all mock units
- * @param   dest_dir[in]   Directory contaning the files with the energy counters
+ * @param   dest_dir[in]   Directory contaning the files with the energy counters (NULL if disabled)
  * @param   is_verbose[in] Whether the verbose mode should be enabled
  * @param   n_mocks[in]    Amount of mock units
  * @param   mock_watts[in] Fixed power consumption for each mock unit
+ * @param   interval_ms[in] Interval in milliseconds between two collections
  */
 void mock_init(Component_t *mocks, const char *dest_dir, const bool is_verbose,
-               const uint32_t n_mocks, uint32_t *mock_watts, const uint32_t interval)
+               const uint32_t n_mocks, uint32_t *mock_watts, const uint64_t interval_ms)
 {
     memset(mocks, 0, sizeof(Component_t));
     mocks->is_verbose = is_verbose;
     mocks->type = MOCK;
+    mocks->vendor = VENDOR_UNKNOWN;
     mocks->fini = mock_fini;
     mocks->update = mock_update;
-    mocks->n_siblings = n_mocks;
+
+    if (component_alloc(mocks, n_mocks) != 0)
+        exit(EXIT_FAILURE);
 
     if (is_verbose)
         printf("Using %u mock units(s)\n", mocks->n_siblings);
 
-    assert(mocks->n_siblings < N_SIBLINGS_MAX);
-
     for (uint32_t i = 0; i < mocks->n_siblings; i++) {
         Unit_t *mock = &mocks->siblings[i];
         mock->id = i;
         mock->fixed_watts = mock_watts[i];
-        mock->energy_interval = mock_watts[i] * interval;
-
-        char output_path[PATH_MAX];
+        mocks->counters.energy_interval_uj[i] = (uint64_t)mock_watts[i] * interval_ms * 1000;
 
         /* Opening normalized file (Joules) */
-        snprintf(output_path, sizeof(output_path), "%s/mock_%d_energy", dest_dir, mock->id);
-        mock->energy_fd = fopen(output_path, "w");
-        if (!mock->energy_fd)
-        {
-            fprintf(stderr, "Failed to open output file: %s\n", output_path);
+        snprintf(mock->name, sizeof(mock->name), "mock_%d", mock->id);
+        if (output_open(mock, dest_dir) != 0)
             exit(EXIT_FAILURE);
-        }
     }
 }
 
@@ -107,7 +107,7 @@ void mock_fini(Component_t *mocks)
     for (uint32_t i = 0; i < mocks->n_siblings; ++i)
     {
         Unit_t *package = &mocks->siblings[i];
-        fclose(package->energy_fd);
+        output_close(package);
     }
 }
 
@@ -122,12 +122,12 @@ void mock_update(Component_t *mocks)
 
     for (uint32_t i = 0; i < mocks->n_siblings; ++i)
     {
-        Unit_t *mock = &mocks->siblings[i];
-        _mock_update_files(mock);
+        const Counters_t *counters = &mocks->counters;
+        _mock_update_files(mocks, i);
 
         if (is_verbose)
-            printf("Mock %u: %lu J (fixed: %u W, accumulator: %lu J)\n",
-                   i, mock->energy_interval, mock->fixed_watts, mock->energy_acc);
+            printf("Mock %u: %lu J (fixed: %u W, accumulator: %lu J)\n", i, counters->energy_interval[i],
+                   mocks->siblings[i].fixed_watts, counters->energy_acc[i]);
     }
 }
 
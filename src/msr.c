@@ -0,0 +1,144 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* EnergyCounter: Fetch and expose energy counters.
+* msr.c: Access layer for model specific registers (MSR). Each MSR device
+*        file is opened once and kept open for the lifetime of the daemon.
+*
+* URL       https://github.com/HewlettPackard/EnergyCounter
+******************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "msr.h"
+
+#define MSR_PATH_MAX 32
+
+typedef struct Msr
+{
+    int      fd;
+    uint32_t n_refs;
+} Msr_t;
+
+static Msr_t   *_msr_files = NULL;  /* MSR device files indexed by CPU id */
+static uint32_t _msr_n_files = 0;
+
+/**
+ * Make sure the MSR file table can be indexed by a given CPU id
+ *
+ * @param   cpu[in]     Id of the hardware thread (SMT id)
+ * @return  0 on success, -ENOMEM otherwise
+ */
+static int _msr_reserve(const uint32_t cpu)
+{
+    if (cpu < _msr_n_files)
+        return 0;
+
+    const uint32_t n_files = cpu + 1;
+    Msr_t *files = realloc(_msr_files, n_files * sizeof(Msr_t));
+    if (files == NULL)
+        return -ENOMEM;
+
+    for (uint32_t i = _msr_n_files; i < n_files; i++)
+    {
+        files[i].fd = -1;
+        files[i].n_refs = 0;
+    }
+
+    _msr_files = files;
+    _msr_n_files = n_files;
+
+    return 0;
+}
+
+/**
+ * Open the MSR device file of a CPU, or take a reference if already opened
+ *
+ * @param   cpu[in]     Id of the hardware thread (SMT id)
+ * @return  0 on success, a negative error code otherwise
+ */
+int msr_open(const uint32_t cpu)
+{
+    int ret = _msr_reserve(cpu);
+    if (ret != 0)
+        return ret;
+
+    Msr_t *msr = &_msr_files[cpu];
+    if (msr->n_refs == 0)
+    {
+        char file_path[MSR_PATH_MAX];
+        snprintf(file_path, MSR_PATH_MAX, "/dev/cpu/%u/msr", cpu);
+
+        msr->fd = open(file_path, O_RDONLY | O_CLOEXEC);
+        if (msr->fd < 0)
+            return -errno;
+    }
+
+    msr->n_refs++;
+
+    return 0;
+}
+
+/**
+ * Release a reference on the MSR device file of a CPU
+ *
+ * @param   cpu[in]     Id of the hardware thread (SMT id)
+ */
+void msr_close(const uint32_t cpu)
+{
+    if (cpu >= _msr_n_files || _msr_files[cpu].n_refs == 0)
+        return;
+
+    Msr_t *msr = &_msr_files[cpu];
+    if (--msr->n_refs > 0)
+        return;
+
+    close(msr->fd);
+    msr->fd = -1;
+}
+
+/**
+ * Read the content of a model specific register (MSR). The MSR device file
+ * must have been opened with msr_open().
+ *
+ * @param   cpu[in]     Id of the hardware thread (SMT id)
+ * @param   reg[in]     MSR address
+ * @param   value[out]  Content of the register
+ * @return  0 on success, a negative error code otherwise
+ */
+int msr_read(const uint32_t cpu, const uint32_t reg, uint64_t *value)
+{
+    if (cpu >= _msr_n_files || _msr_files[cpu].fd < 0)
+        return -EBADF;
+
+    const ssize_t ret = pread(_msr_files[cpu].fd, value, sizeof(*value), reg);
+    if (ret < 0)
+        return -errno;
+    if (ret != sizeof(*value))
+        return -EIO;
+
+    return 0;
+}
@@ -33,6 +33,8 @@
 #include <string.h>
 #include <linux/limits.h>
 #include "interface.h"
+#include "output.h"
+#include "common.h"
 
 /* Prototypes used externaly */
 void nvidia_gpu_fini(Component_t *gpus);
@@ -54,43 +56,34 @@ static int get_total_energy(unsigned int gpu_id, dcgmFieldValue_v1 *field, int n
     _dcgm_energy[gpu_id] = field[0].value.i64;
     return 0;
 }
-#endif /* NVIDIA_GPU */
 
 /**
- * Write latest counter value in the destination file for a given GPU
+ * Stage the latest counter value of a given GPU
  *
- * @param   dev[in]  Unit structure for the GPU
+ * @param   gpus[inout]  GPU structure
+ * @param   i[in]        Index of the GPU
  */
-
-static void _nvidia_device_update_files(Unit_t *dev)
+static void _nvidia_device_fetch_energy(Component_t *gpus, const uint32_t i)
 {
-#ifdef NVIDIA_GPU
-    uint64_t last_energy_raw = dev->energy_raw;
+    Counters_t *counters = &gpus->counters;
 
-    dev->energy_raw = _dcgm_energy[dev->id];
+    counters->energy_raw_next[i] = _dcgm_energy[gpus->siblings[i].id];
+    counters->timestamp[i] = get_time_ns();
 
     /* First iteration */
-    if (!last_energy_raw)
-        return;
+    if (counters->energy_raw[i] == 0)
+        counters->energy_raw[i] = counters->energy_raw_next[i];
 
     /* XXX: This type should be large enough to never overflow */
-    assert(dev->energy_raw >= last_energy_raw);
-
-    dev->energy_interval = (dev->energy_raw - last_energy_raw) / 1E3;
-    dev->energy_acc += dev->energy_interval;
-
-    /* Updating the file */
-    fprintf(dev->energy_fd, "%lu Joules", dev->energy_acc);
-    rewind(dev->energy_fd); /* Flush buffer and prepare for overwriting next value */
-
-#endif /* NVIDIA_GPU */
+    assert(counters->energy_raw_next[i] >= counters->energy_raw[i]);
 }
+#endif /* NVIDIA_GPU */
 
 /**
  * Initialize this GPU module
  *
  * @param   gpus[out]       GPU structure to initialize all GPUs
- * @param   dest_dir[in]    Directory contaning the files with the energy counters
+ * @param   dest_dir[in]    Directory contaning the files with the energy counters (NULL if disabled)
  * @param   is_verbose[in]  Whether the verbose mode should be enabled
  * @param   is_disabled[in] Whether the module should be disabled
  */
@@ -139,12 +132,15 @@ void nvidia_gpu_init(Component_t *gpus, const char *dest_dir, const bool is_verb
     if (count == 0)
         goto exit;
 
-    gpus->n_siblings = (uint32_t)count;
+    if (component_alloc(gpus, (uint32_t)count) != 0)
+    {
+        ret = DCGM_ST_MEMORY;
+        goto exit;
+    }
+
     if (is_verbose)
         printf("%u NVIDIA GPU devices found\n", gpus->n_siblings);
 
-    assert(gpus->n_siblings < N_SIBLINGS_MAX);
-
     /* Create a group. */
     ret = dcgmGroupCreate(_dcgm_handle, DCGM_GROUP_DEFAULT, _dcgm_group_name, &_dcgm_group);
     if (ret != DCGM_ST_OK)
@@ -175,18 +171,17 @@ void nvidia_gpu_init(Component_t *gpus, const char *dest_dir, const bool is_verb
             goto exit;
         }
 
+        /* The counter is in millijoules */
+        gpus->counters.energy_scale[i] = energy_scale(1000.0);
+
         /* Converting the PCIe address */
         attributes.identifiers.pciBusId[11] = '\0';
         dev->bus_id = (uint32_t)strtol(&attributes.identifiers.pciBusId[9], NULL, 16);
 
-        char output_path[PATH_MAX];
-
         /* Opening normalized file (Joules) */
-        snprintf(output_path, sizeof(output_path), "%s/gpu_%2.2lx_energy", dest_dir, dev->bus_id);
-        dev->energy_fd = fopen(output_path, "w");
-        if (!dev->energy_fd)
+        snprintf(dev->name, sizeof(dev->name), "gpu_%2.2lx", dev->bus_id);
+        if (output_open(dev, dest_dir) != 0)
         {
-            fprintf(stderr, "Failed to open output file: %s\n", output_path);
             ret = DCGM_ST_GENERIC_ERROR;
             goto exit;
         }
@@ -214,7 +209,7 @@ void nvidia_gpu_fini(Component_t *gpus)
     for (uint32_t i = 0; i < gpus->n_siblings; ++i)
     {
         Unit_t *dev = &gpus->siblings[i];
-        fclose(dev->energy_fd);
+        output_close(dev);
     }
 
     dcgmGroupDestroy(_dcgm_handle, _dcgm_group);
@@ -256,16 +251,24 @@ void nvidia_gpu_update(Component_t *gpus)
         fprintf(stderr, "Cannot get latest values: %s\n", errorString(ret));
         goto error;
     }
+
+    for (uint32_t i = 0; i < gpus->n_siblings; ++i)
+        _nvidia_device_fetch_energy(gpus, i);
+
+    counters_accumulate(&gpus->counters, gpus->n_siblings, UINT64_MAX);
 #endif /* NVIDIA_GPU */
 
     for (uint32_t i = 0; i < gpus->n_siblings; ++i)
     {
         Unit_t *dev = &gpus->siblings[i];
-        _nvidia_device_update_files(dev);
+        const Counters_t *counters = &gpus->counters;
+
+        /* Updating the file */
+        output_write(dev, counters->energy_acc[i]);
 
         if (is_verbose)
-            printf("Nvidia GPU %u (0x%2.2lx): %lu J (accumulator: %lu J, raw: %lu)\n",
-                   dev->id, dev->bus_id, dev->energy_interval, dev->energy_acc, dev->energy_raw);
+            printf("Nvidia GPU %u (0x%2.2lx): %lu J (accumulator: %lu J, raw: %lu)\n", dev->id, dev->bus_id,
+                   counters->energy_interval[i], counters->energy_acc[i], counters->energy_raw[i]);
     }
 
 #ifdef NVIDIA_GPU
@@ -0,0 +1,180 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* EnergyCounter: Fetch and expose energy counters.
+* output.c: Writer for the per-unit output files. Each value is formatted in
+*           a local buffer and written with a single pwrite() at offset 0.
+*
+* URL       https://github.com/HewlettPackard/EnergyCounter
+******************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/limits.h>
+#include "interface.h"
+#include "output.h"
+
+#define OUTPUT_SUFFIX     " Joules"
+#define OUTPUT_SUFFIX_LEN (sizeof(OUTPUT_SUFFIX) - 1)
+#define OUTPUT_GENERATION "generation"
+
+static char _output_generation_path[PATH_MAX];
+
+/**
+ * Open the output file of a unit, named after the unit (<name>_energy)
+ *
+ * @param   unit[inout]   Unit structure with its name set
+ * @param   dest_dir[in]  Directory contaning the files with the energy counters (NULL if disabled)
+ * @return  0 on success, a negative error code otherwise
+ */
+int output_open(Unit_t *unit, const char *dest_dir)
+{
+    unit->energy_fd = -1;
+    unit->energy_len = 0;
+
+    /* Output files are disabled */
+    if (dest_dir == NULL)
+        return 0;
+
+    char output_path[PATH_MAX];
+    snprintf(output_path, sizeof(output_path), "%s/%s_energy", dest_dir, unit->name);
+
+    unit->energy_fd = open(output_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (unit->energy_fd < 0)
+    {
+        int ret = -errno;
+        fprintf(stderr, "Failed to open output file: %s\n", output_path);
+        return ret;
+    }
+
+    return 0;
+}
+
+/**
+ * Overwrite the output file of a unit with the value of its accumulator
+ *
+ * @param   unit[inout]      Unit structure
+ * @param   energy_acc[in]   Energy accumulator of the unit in Joules
+ */
+void output_write(Unit_t *unit, const uint64_t energy_acc)
+{
+    char buf[OUTPUT_U64_LEN_MAX + OUTPUT_SUFFIX_LEN];
+
+    if (unit->energy_fd < 0)
+        return;
+
+    uint32_t len = output_format_u64(buf, energy_acc);
+    memcpy(&buf[len], OUTPUT_SUFFIX, OUTPUT_SUFFIX_LEN);
+    len += OUTPUT_SUFFIX_LEN;
+
+    if (pwrite(unit->energy_fd, buf, len, 0) != len)
+    {
+        fprintf(stderr, "Failed to update output file of %s: %s\n", unit->name, strerror(errno));
+        return;
+    }
+
+    /* Drop the trailing characters of a longer previous value */
+    if (len < unit->energy_len && ftruncate(unit->energy_fd, len) != 0)
+        fprintf(stderr, "Failed to truncate output file of %s: %s\n", unit->name, strerror(errno));
+
+    unit->energy_len = len;
+}
+
+/**
+ * Close the output file of a unit
+ *
+ * @param   unit[inout]   Unit structure
+ */
+void output_close(Unit_t *unit)
+{
+    if (unit->energy_fd < 0)
+        return;
+
+    close(unit->energy_fd);
+    unit->energy_fd = -1;
+}
+
+/**
+ * Enable the generation file, rewritten after all the other outputs of a
+ * publication. Readers can wait for IN_CLOSE_WRITE on it with inotify
+ * instead of polling the counter files.
+ *
+ * @param   dest_dir[in]  Directory contaning the files with the energy counters (NULL if disabled)
+ */
+void output_generation_init(const char *dest_dir)
+{
+    _output_generation_path[0] = '\0';
+
+    if (dest_dir == NULL)
+        return;
+
+    snprintf(_output_generation_path, sizeof(_output_generation_path), "%s/%s",
+             dest_dir, OUTPUT_GENERATION);
+
+    /* Drop a larger generation left by a previous instance */
+    unlink(_output_generation_path);
+}
+
+/**
+ * Write the generation of the last publication. The file is closed after
+ * each update so every publication raises exactly one IN_CLOSE_WRITE. The
+ * generation only grows, so the previous value is always overwritten.
+ *
+ * @param   generation[in]   Generation of the publication
+ */
+void output_generation_write(const uint64_t generation)
+{
+    char buf[OUTPUT_U64_LEN_MAX + 1];
+
+    if (_output_generation_path[0] == '\0')
+        return;
+
+    int fd = open(_output_generation_path, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Failed to open generation file: %s\n", strerror(errno));
+        return;
+    }
+
+    uint32_t len = output_format_u64(buf, generation);
+    buf[len++] = '\n';
+
+    if (pwrite(fd, buf, len, 0) != len)
+        fprintf(stderr, "Failed to update generation file: %s\n", strerror(errno));
+
+    close(fd);
+}
+
+/**
+ * Remove the generation file
+ */
+void output_generation_fini(void)
+{
+    if (_output_generation_path[0] == '\0')
+        return;
+
+    unlink(_output_generation_path);
+    _output_generation_path[0] = '\0';
+}
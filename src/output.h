@@ -0,0 +1,67 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* EnergyCounter: Fetch and expose energy counters.
+* output.h: Writer for the per-unit output files.
+*
+* URL       https://github.com/HewlettPackard/EnergyCounter
+******************************************************************************/
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdint.h>
+#include <string.h>
+#include "interface.h"
+
+#define OUTPUT_U64_LEN_MAX 20   /* Digits of UINT64_MAX */
+
+/**
+ * Format an unsigned integer in decimal
+ *
+ * @param   buf[out]    Destination buffer of at least OUTPUT_U64_LEN_MAX bytes
+ * @param   value[in]   Value to format
+ * @return  Amount of characters written (not null-terminated)
+ */
+static inline uint32_t output_format_u64(char *buf, uint64_t value)
+{
+    char digits[OUTPUT_U64_LEN_MAX];
+    uint32_t n = 0;
+
+    do
+    {
+        digits[OUTPUT_U64_LEN_MAX - 1 - n++] = '0' + (value % 10);
+        value /= 10;
+    } while (value > 0);
+
+    memcpy(buf, &digits[OUTPUT_U64_LEN_MAX - n], n);
+
+    return n;
+}
+
+int output_open(Unit_t *unit, const char *dest_dir);
+void output_write(Unit_t *unit, const uint64_t energy_acc);
+void output_close(Unit_t *unit);
+void output_generation_init(const char *dest_dir);
+void output_generation_write(const uint64_t generation);
+void output_generation_fini(void);
+
+#endif /* OUTPUT_H */
@@ -0,0 +1,527 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* EnergyCounter: Fetch and expose energy counters.
+* query.c: Local query server (AF_UNIX socket) answering from memory.
+*
+* URL       https://github.com/HewlettPackard/EnergyCounter
+******************************************************************************/
+
+#define _GNU_SOURCE     /* accept4() */
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <linux/limits.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "interface.h"
+#include "common.h"
+#include "buffer.h"
+#include "scheduler.h"
+#include "snapshot.h"
+#include "history.h"
+#include "rollup.h"
+
+#define QUERY_CLIENTS_MAX   64
+#define QUERY_REQUEST_MAX   256          /* Longest request line            */
+#define QUERY_PENDING_MAX   (1 << 20)    /* Pending replies of a slow client */
+
+typedef struct Client
+{
+    Watch_t    watch;
+    bool       is_used;
+    bool       is_writing;              /* EPOLLOUT is watched             */
+    char       request[QUERY_REQUEST_MAX];
+    uint32_t   request_len;
+    Buffer_t   pending;                 /* Replies not sent yet            */
+    size_t     pending_off;
+} Client_t;
+
+static Scheduler_t       *_query_sched = NULL;
+static const Component_t *_query_components = NULL;
+static uint32_t           _query_n_components = 0;
+static uint64_t           _query_generation = 0;
+static Watch_t            _query_listener = { .fd = -1 };
+static char               _query_path[PATH_MAX];
+static Client_t           _query_clients[QUERY_CLIENTS_MAX];
+static RollupBucket_t     _query_buckets[ROLLUP_BUCKETS_MAX];
+
+/**
+ * Disconnect a client and release its buffers
+ *
+ * @param   client[inout]  Client structure
+ */
+static void _query_client_close(Client_t *client)
+{
+    sched_unwatch(_query_sched, &client->watch);
+    close(client->watch.fd);
+    buffer_free(&client->pending);
+    memset(client, 0, sizeof(Client_t));
+}
+
+/**
+ * Append an error reply
+ */
+static void _query_error(Client_t *client, const char *error)
+{
+    buffer_append_str(&client->pending, "{\"error\":\"");
+    buffer_append_str(&client->pending, error);
+    buffer_append_str(&client->pending, "\"}\n");
+}
+
+/**
+ * Parse an unsigned integer of a request
+ *
+ * @return  true on success
+ */
+static bool _query_parse_u64(const char *value, uint64_t *result)
+{
+    char *end;
+
+    if (value == NULL)
+        return false;
+
+    errno = 0;
+    *result = strtoull(value, &end, 10);
+
+    return (errno == 0 && *end == '\0' && end != value);
+}
+
+/**
+ * Answer a request on the history of a unit:
+ * ENERGY <unit> <t0> <t1> for the energy between two timestamps
+ * (monotonic, ns) and POWER <unit> <seconds> for the last seconds.
+ *
+ * @param   client[inout]  Client structure
+ * @param   is_energy[in]  Whether this is an ENERGY request
+ * @param   saveptr[inout] Remaining tokens of the request
+ */
+static void _query_answer_history(Client_t *client, const bool is_energy, char **saveptr)
+{
+    const char *name = strtok_r(NULL, " \t\r", saveptr);
+    uint64_t t0, t1;
+
+    if (is_energy)
+    {
+        if (!_query_parse_u64(strtok_r(NULL, " \t\r", saveptr), &t0) ||
+            !_query_parse_u64(strtok_r(NULL, " \t\r", saveptr), &t1) || name == NULL)
+        {
+            _query_error(client, "usage: ENERGY <unit> <t0> <t1>");
+            return;
+        }
+    }
+    else
+    {
+        uint64_t duration;
+
+        if (!_query_parse_u64(strtok_r(NULL, " \t\r", saveptr), &duration) || name == NULL)
+        {
+            _query_error(client, "usage: POWER <unit> <seconds>");
+            return;
+        }
+
+        t1 = get_time_ns();
+        t0 = (t1 > duration * NS_PER_S) ? t1 - duration * NS_PER_S : 0;
+    }
+
+    HistoryWindow_t window;
+    const int ret = history_window(name, t0, t1, &window);
+
+    if (ret == -ENOENT)
+    {
+        _query_error(client, "unknown unit or history disabled");
+        return;
+    }
+    if (ret == -ENODATA)
+    {
+        _query_error(client, "not enough samples");
+        return;
+    }
+
+    Buffer_t *buf = &client->pending;
+    buffer_append_str(buf, "{\"unit\":\"");
+    buffer_append_json(buf, name);
+    buffer_append_str(buf, "\",\"from\":");
+    buffer_append_u64(buf, window.from);
+    buffer_append_str(buf, ",\"to\":");
+    buffer_append_u64(buf, window.to);
+    buffer_append_str(buf, ",\"energy_uj\":");
+    buffer_append_u64(buf, window.energy_uj);
+    buffer_append_str(buf, ",\"average_power_mw\":");
+    buffer_append_u64(buf, window.average_power);
+    buffer_append_str(buf, ",\"peak_power_mw\":");
+    buffer_append_u64(buf, window.peak_power);
+    buffer_append_str(buf, "}\n");
+}
+
+/**
+ * Answer a request on the rollups of a unit:
+ * ROLLUP <unit> <1s|10s|1m|1h> [<count>] for the last buckets.
+ *
+ * @param   client[inout]  Client structure
+ * @param   saveptr[inout] Remaining tokens of the request
+ */
+static void _query_answer_rollup(Client_t *client, char **saveptr)
+{
+    const char *name = strtok_r(NULL, " \t\r", saveptr);
+    const char *resolution = strtok_r(NULL, " \t\r", saveptr);
+    const char *count = strtok_r(NULL, " \t\r", saveptr);
+    uint64_t n_buckets = ROLLUP_BUCKETS_MAX;
+    int level;
+
+    for (level = 0; resolution != NULL && level < ROLLUP_LEVELS_MAX; level++)
+        if (strcmp(resolution, rollup_level_str[level]) == 0)
+            break;
+
+    if (name == NULL || resolution == NULL || level == ROLLUP_LEVELS_MAX ||
+        (count != NULL && !_query_parse_u64(count, &n_buckets)))
+    {
+        _query_error(client, "usage: ROLLUP <unit> <1s|10s|1m|1h> [<count>]");
+        return;
+    }
+
+    uint32_t n_found;
+    if (rollup_get(name, level, MIN(n_buckets, ROLLUP_BUCKETS_MAX), _query_buckets, &n_found) != 0)
+    {
+        _query_error(client, "unknown unit or rollups disabled");
+        return;
+    }
+
+    Buffer_t *buf = &client->pending;
+    buffer_append_str(buf, "{\"unit\":\"");
+    buffer_append_json(buf, name);
+    buffer_append_str(buf, "\",\"resolution\":\"");
+    buffer_append_str(buf, rollup_level_str[level]);
+    buffer_append_str(buf, "\",\"buckets\":[");
+
+    for (uint32_t i = 0; i < n_found; i++)
+    {
+        const RollupBucket_t *bucket = &_query_buckets[i];
+
+        buffer_append_str(buf, (i > 0) ? ",{\"start\":" : "{\"start\":");
+        buffer_append_u64(buf, bucket->start);
+        buffer_append_str(buf, ",\"energy_uj\":");
+        buffer_append_u64(buf, bucket->energy_uj);
+        buffer_append_str(buf, ",\"min_power_mw\":");
+        buffer_append_u64(buf, bucket->min_power);
+        buffer_append_str(buf, ",\"mean_power_mw\":");
+        buffer_append_u64(buf, get_power_mw(bucket->energy_uj, bucket->duration));
+        buffer_append_str(buf, ",\"max_power_mw\":");
+        buffer_append_u64(buf, bucket->max_power);
+        buffer_append_str(buf, "}");
+    }
+
+    buffer_append_str(buf, "]}\n");
+}
+
+/**
+ * Parse a request line and append its reply to the pending buffer.
+ * Requests are either made of filters: ALL, TYPE <type> and
+ * SINCE <generation>, e.g. "TYPE GPU SINCE 42", or are history requests
+ * (ENERGY, POWER and ROLLUP).
+ *
+ * @param   client[inout]  Client structure
+ * @param   line[inout]    Request (null terminated, modified)
+ */
+static void _query_answer(Client_t *client, char *line)
+{
+    SnapshotFilter_t filter = { .type = TYPE_UNKNOWN, .since = 0 };
+    char *saveptr = NULL;
+    const char *error = NULL;
+    char *token = strtok_r(line, " \t\r", &saveptr);
+
+    if (token != NULL && (strcasecmp(token, "ENERGY") == 0 || strcasecmp(token, "POWER") == 0))
+    {
+        _query_answer_history(client, strcasecmp(token, "ENERGY") == 0, &saveptr);
+        return;
+    }
+
+    if (token != NULL && strcasecmp(token, "ROLLUP") == 0)
+    {
+        _query_answer_rollup(client, &saveptr);
+        return;
+    }
+
+    for (; token != NULL && error == NULL; token = strtok_r(NULL, " \t\r", &saveptr))
+    {
+        if (strcasecmp(token, "ALL") == 0)
+            continue;
+
+        const bool is_type = (strcasecmp(token, "TYPE") == 0);
+        const bool is_since = (strcasecmp(token, "SINCE") == 0);
+        char *value = strtok_r(NULL, " \t\r", &saveptr);
+
+        if (!is_type && !is_since)
+        {
+            error = "unknown request";
+        }
+        else if (value == NULL)
+        {
+            error = "missing value";
+        }
+        else if (is_type)
+        {
+            for (filter.type = 0; filter.type < TYPE_UNKNOWN; filter.type++)
+                if (strcasecmp(value, type_str[filter.type]) == 0)
+                    break;
+
+            if (filter.type == TYPE_UNKNOWN)
+                error = "unknown type";
+        }
+        else if (!_query_parse_u64(value, &filter.since))
+        {
+            error = "invalid generation";
+        }
+    }
+
+    if (error != NULL)
+    {
+        _query_error(client, error);
+        return;
+    }
+
+    /* Same frame as the JSON snapshot, on a single line */
+    snapshot_render(&client->pending, SNAPSHOT_JSON, _query_components, _query_n_components,
+                    _query_generation, get_time_ns(), &filter);
+}
+
+/**
+ * Send as many pending replies as the socket accepts. The remaining ones
+ * are sent when the socket is writable again.
+ *
+ * @param   client[inout]  Client structure
+ * @return  0 on success, a negative error code if the client must be closed
+ */
+static int _query_client_flush(Client_t *client)
+{
+    while (client->pending_off < client->pending.len)
+    {
+        const ssize_t ret = send(client->watch.fd, &client->pending.data[client->pending_off],
+                                 client->pending.len - client->pending_off,
+                                 MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (ret < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            if (errno == EINTR)
+                continue;
+            return -errno;
+        }
+
+        client->pending_off += ret;
+    }
+
+    const bool is_done = (client->pending_off == client->pending.len);
+    if (is_done)
+    {
+        buffer_reset(&client->pending);
+        client->pending_off = 0;
+    }
+    else if (client->pending.len - client->pending_off > QUERY_PENDING_MAX)
+    {
+        /* The client does not read its replies */
+        return -ENOBUFS;
+    }
+
+    /* Only watch the socket for writing while replies are pending */
+    if (is_done == client->is_writing)
+    {
+        client->is_writing = !is_done;
+        return sched_rewatch(_query_sched, &client->watch,
+                             EPOLLIN | (client->is_writing ? EPOLLOUT : 0));
+    }
+
+    return 0;
+}
+
+/**
+ * Read the requests of a client, all complete lines are answered and sent
+ * in a single batch
+ *
+ * @param   arg[inout]   Client structure
+ * @param   events[in]   Epoll events
+ */
+static void _query_client_handle(void *arg, const uint32_t events)
+{
+    Client_t *client = (Client_t *)arg;
+
+    if (events & (EPOLLERR | EPOLLHUP))
+        goto close;
+
+    if (events & EPOLLIN)
+    {
+        const ssize_t ret = recv(client->watch.fd, &client->request[client->request_len],
+                                 QUERY_REQUEST_MAX - client->request_len, MSG_DONTWAIT);
+        if (ret == 0)
+            goto close;
+        if (ret < 0 && errno != EAGAIN && errno != EINTR)
+            goto close;
+
+        client->request_len += (ret > 0) ? ret : 0;
+
+        char *line = client->request;
+        char *end;
+        while ((end = memchr(line, '\n', client->request_len - (line - client->request))) != NULL)
+        {
+            *end = '\0';
+            _query_answer(client, line);
+            line = end + 1;
+        }
+
+        /* Keep the incomplete request for the next read */
+        client->request_len -= line - client->request;
+        memmove(client->request, line, client->request_len);
+
+        if (client->request_len == QUERY_REQUEST_MAX)
+            goto close;
+    }
+
+    if (_query_client_flush(client) != 0)
+        goto close;
+
+    return;
+
+close:
+    _query_client_close(client);
+}
+
+/**
+ * Accept the pending connections
+ *
+ * @param   arg[in]      Unused
+ * @param   events[in]   Epoll events
+ */
+static void _query_accept(void *arg, const uint32_t events)
+{
+    while (true)
+    {
+        const int fd = accept4(_query_listener.fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+            return;
+
+        Client_t *client = NULL;
+        for (int i = 0; i < QUERY_CLIENTS_MAX && client == NULL; i++)
+            if (!_query_clients[i].is_used)
+                client = &_query_clients[i];
+
+        if (client == NULL)
+        {
+            close(fd);
+            continue;
+        }
+
+        client->is_used = true;
+        client->watch.fd = fd;
+        client->watch.handle = _query_client_handle;
+        client->watch.arg = client;
+
+        if (sched_watch(_query_sched, &client->watch, EPOLLIN) != 0)
+        {
+            close(fd);
+            memset(client, 0, sizeof(Client_t));
+        }
+    }
+}
+
+/**
+ * Create the query socket and serve it from the event loop of the scheduler
+ *
+ * @param   path[in]         Path of the socket
+ * @param   sched[inout]     Scheduler running the event loop
+ * @param   components[in]   Array of all components
+ * @param   n_components[in] Amount of components
+ * @return  0 on success, a negative error code otherwise
+ */
+int query_init(const char *path, Scheduler_t *sched, const Component_t *components,
+               const uint32_t n_components)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return -ENAMETOOLONG;
+
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    strncpy(_query_path, path, PATH_MAX - 1);
+
+    _query_sched = sched;
+    _query_components = components;
+    _query_n_components = n_components;
+
+    _query_listener.fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (_query_listener.fd < 0)
+        return -errno;
+
+    /* Remove a socket left by a previous instance */
+    unlink(_query_path);
+
+    int ret = 0;
+    if (bind(_query_listener.fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        chmod(_query_path, 0666) != 0 ||
+        listen(_query_listener.fd, QUERY_CLIENTS_MAX) != 0)
+        ret = -errno;
+
+    _query_listener.handle = _query_accept;
+    if (ret == 0)
+        ret = sched_watch(sched, &_query_listener, EPOLLIN);
+
+    if (ret != 0)
+    {
+        close(_query_listener.fd);
+        _query_listener.fd = -1;
+    }
+
+    return ret;
+}
+
+/**
+ * Disconnect all clients and remove the socket
+ */
+void query_fini(void)
+{
+    if (_query_listener.fd < 0)
+        return;
+
+    for (int i = 0; i < QUERY_CLIENTS_MAX; i++)
+        if (_query_clients[i].is_used)
+            _query_client_close(&_query_clients[i]);
+
+    sched_unwatch(_query_sched, &_query_listener);
+    close(_query_listener.fd);
+    _query_listener.fd = -1;
+    unlink(_query_path);
+}
+
+/**
+ * Record the generation of the last publication, replies always describe
+ * the components as they are in memory
+ *
+ * @param   generation[in]   Generation of the publication
+ */
+void query_publish(const uint64_t generation)
+{
+    _query_generation = generation;
+}
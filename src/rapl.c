@@ -0,0 +1,1075 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* EnergyCounter: Fetch and expose energy counters.
+* rapl.c: Per-package sampler for RAPL energy counters. The domains (PKG,
+*         DRAM, PP0, PP1, PSYS) of each package are probed once, then all
+*         enabled domains of a package are read in one burst on the same
+*         core and share a single timestamp. The CPU and DRAM modules
+*         consume the same burst during a scheduler round. Counters are
+*         read from the MSRs, from the power PMU of perf_event (one read
+*         per package, no wraparound) or from the powercap framework.
+*
+* URL       https://github.com/HewlettPackard/EnergyCounter
+******************************************************************************/
+
+#define _GNU_SOURCE     /* pthread_attr_setaffinity_np() */
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/limits.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <math.h>
+#include "interface.h"
+#include "common.h"
+#include "msr.h"
+#include "rapl.h"
+#include "topology.h"
+
+#define MSR_AMD_PACKAGE_ENERGY         0xc001029b
+#define MSR_INTEL_PACKAGE_ENERGY       0x611
+#define MSR_INTEL_DRAM_PACKAGE_ENERGY  0x619
+#define MSR_INTEL_PP0_ENERGY           0x639
+#define MSR_INTEL_PP1_ENERGY           0x641
+#define MSR_INTEL_PLATFORM_ENERGY      0x64d
+#define MSR_INTEL_PACKAGE_POWER_INFO   0x614
+#define MSR_INTEL_DRAM_POWER_INFO      0x61c
+#define MSR_POWER_INFO_MASK            0x7fff
+#define MSR_POWER_UNIT_MASK            0xf
+
+#define POWERCAP_PATH  "/sys/class/powercap"
+#define PERF_PMU_PATH  "/sys/bus/event_source/devices/power"
+
+#define RAPL_NO_TICK        UINT64_MAX
+#define RAPL_THREAD_CPUS_MAX 256
+#define RAPL_POWER_DEFAULT  1000.0  /* Watts, bound of a domain without power info */
+#define RAPL_POWER_MARGIN   2.0     /* Turbo power above the maximum or TDP        */
+#define RAPL_PERF_EXACT_BITS 26     /* 2^-26 J is exact in the energy scales       */
+
+/* Counter of a domain: MSR, powercap zone or perf event. The counter goes
+ * from 0 to max_value, the sampler unrolls it in a 64-bit raw value. */
+typedef struct RaplZone
+{
+    int           fd;                                   /* energy_uj file or event   */
+    uint64_t      max_value;
+    uint64_t      last_value;                           /* Last value read           */
+    uint64_t      wrap_period_ns;                       /* Shortest time to wrap     */
+} RaplZone_t;
+
+typedef struct RaplPackage
+{
+    uint32_t      core_id;                              /* CPU used to read the MSRs */
+    bool          is_available[RAPL_DOMAINS_MAX];       /* Domains found at startup  */
+    double        energy_resolution[RAPL_DOMAINS_MAX];  /* Joules per raw unit       */
+    RaplZone_t    zones[RAPL_DOMAINS_MAX];
+    int           group_fd;                             /* Perf group leader         */
+    uint32_t      n_events;                             /* Events of the perf group  */
+    int           events[RAPL_DOMAINS_MAX];             /* Domain of each event      */
+    RaplSample_t  sample;                               /* Latest burst              */
+} RaplPackage_t;
+
+/* Domain which does not use the energy unit of the power unit MSR */
+typedef struct RaplFixedUnit
+{
+    uint32_t      model;
+    int           domain;
+    double        energy_resolution;                    /* Joules per raw unit       */
+} RaplFixedUnit_t;
+
+static const uint32_t _rapl_msr[][RAPL_DOMAINS_MAX] =
+{
+    [INTEL] = {
+        [RAPL_PKG]  = MSR_INTEL_PACKAGE_ENERGY,
+        [RAPL_DRAM] = MSR_INTEL_DRAM_PACKAGE_ENERGY,
+        [RAPL_PP0]  = MSR_INTEL_PP0_ENERGY,
+        [RAPL_PP1]  = MSR_INTEL_PP1_ENERGY,
+        [RAPL_PSYS] = MSR_INTEL_PLATFORM_ENERGY,
+    },
+    [AMD] = {
+        [RAPL_PKG]  = MSR_AMD_PACKAGE_ENERGY,
+    },
+};
+
+/* Intel server models use a fixed DRAM energy unit of 15.3 uJ, and the
+ * latest ones count the platform energy in Joules */
+static const RaplFixedUnit_t _rapl_fixed_units[] =
+{
+    { 0x3f, RAPL_DRAM, 15.3E-6 },   /* Haswell-X         */
+    { 0x4f, RAPL_DRAM, 15.3E-6 },   /* Broadwell-X       */
+    { 0x55, RAPL_DRAM, 15.3E-6 },   /* Skylake-X         */
+    { 0x57, RAPL_DRAM, 15.3E-6 },   /* Knights Landing   */
+    { 0x85, RAPL_DRAM, 15.3E-6 },   /* Knights Mill      */
+    { 0x6a, RAPL_DRAM, 15.3E-6 },   /* Ice Lake-X        */
+    { 0x6c, RAPL_DRAM, 15.3E-6 },   /* Ice Lake-D        */
+    { 0x8f, RAPL_DRAM, 15.3E-6 },   /* Sapphire Rapids-X */
+    { 0x8f, RAPL_PSYS, 1.0 },
+    { 0xcf, RAPL_DRAM, 15.3E-6 },   /* Emerald Rapids-X  */
+    { 0xcf, RAPL_PSYS, 1.0 },
+    { 0xad, RAPL_DRAM, 15.3E-6 },   /* Granite Rapids-X  */
+    { 0xad, RAPL_PSYS, 1.0 },
+    { 0xae, RAPL_DRAM, 15.3E-6 },   /* Granite Rapids-D  */
+    { 0xae, RAPL_PSYS, 1.0 },
+    { 0xaf, RAPL_DRAM, 15.3E-6 },   /* Sierra Forest     */
+    { 0xaf, RAPL_PSYS, 1.0 },
+};
+
+/* Names of the powercap zones, a package zone is named package-<id> */
+static const char * const _rapl_zone_str[] =
+{
+    [RAPL_PKG]  = "package",
+    [RAPL_DRAM] = "dram",
+    [RAPL_PP0]  = "core",
+    [RAPL_PP1]  = "uncore",
+    [RAPL_PSYS] = "psys",
+};
+
+/* Events of the power PMU */
+static const char * const _rapl_event_str[] =
+{
+    [RAPL_PKG]  = "energy-pkg",
+    [RAPL_DRAM] = "energy-ram",
+    [RAPL_PP0]  = "energy-cores",
+    [RAPL_PP1]  = "energy-gpu",
+    [RAPL_PSYS] = "energy-psys",
+};
+
+static RaplPackage_t **_rapl_packages = NULL;   /* Allocated one by one */
+static uint32_t      _rapl_n_packages = 0;
+static int           _rapl_vendor = VENDOR_UNKNOWN;
+static int           _rapl_backend = RAPL_BACKEND_AUTO;   /* Requested, then used */
+static bool          _rapl_is_enabled[RAPL_DOMAINS_MAX] = { false };
+static uint32_t      _rapl_perf_shifts[RAPL_DOMAINS_MAX] = { 0 };   /* Bits dropped from perf counts */
+static uint32_t      _rapl_n_refs = 0;
+
+/* Sampler threads, one per package pinned to its housekeeping CPU */
+static bool              _rapl_is_threaded = false;
+static uint32_t          _rapl_thread_cpus[RAPL_THREAD_CPUS_MAX];   /* Requested housekeeping CPUs */
+static uint32_t          _rapl_n_thread_cpus = 0;
+static pthread_t        *_rapl_threads = NULL;
+static uint32_t          _rapl_n_threads = 0;
+static pthread_barrier_t _rapl_start;
+static pthread_barrier_t _rapl_done;
+static uint64_t          _rapl_burst_tick = RAPL_NO_TICK;
+static bool              _rapl_is_stopping = false;
+
+/**
+ * Return the energy resolution of a domain
+ *
+ * @param   model[in]     CPU model
+ * @param   domain[in]    RAPL domain
+ * @param   msr_unit[in]  Content of the power unit MSR
+ * @return  Joules per raw unit
+ */
+static double _rapl_energy_resolution(const uint32_t model, const int domain, const uint64_t msr_unit)
+{
+    if (_rapl_vendor == INTEL)
+        for (uint32_t i = 0; i < sizeof(_rapl_fixed_units) / sizeof(_rapl_fixed_units[0]); i++)
+            if (_rapl_fixed_units[i].model == model && _rapl_fixed_units[i].domain == domain)
+                return _rapl_fixed_units[i].energy_resolution;
+
+    return pow(0.5, (double)((msr_unit >> 8) & MSR_ENERGY_UNIT_MASK));
+}
+
+/**
+ * Add the energy counted since the last read of a domain to its raw value,
+ * the counter wraps at most once between two reads
+ *
+ * @param   zone[inout]       Counter of the domain
+ * @param   value[in]         Value read
+ * @param   energy_raw[inout] Raw value of the domain
+ */
+static void _rapl_unroll(RaplZone_t *zone, const uint64_t value, uint64_t *energy_raw)
+{
+    *energy_raw += (value >= zone->last_value) ? value - zone->last_value :
+                   zone->max_value - zone->last_value + value + 1;
+    zone->last_value = value;
+}
+
+/**
+ * Return the shortest time for a counter to wrap
+ *
+ * @param   max_energy[in]  Energy counted before wrapping (J)
+ * @param   max_power[in]   Highest power of the domain (W)
+ */
+static uint64_t _rapl_wrap_period_ns(const double max_energy, const double max_power)
+{
+    return (uint64_t)(max_energy / max_power * NS_PER_S);
+}
+
+/**
+ * Read a file of a powercap zone
+ *
+ * @param   zone[in]    Name of the zone directory
+ * @param   file[in]    Name of the file
+ * @param   value[out]  First line of the file, without the newline
+ * @param   len[in]     Size of the value buffer
+ * @return  0 on success, a negative error code otherwise
+ */
+static int _rapl_powercap_read(const char *zone, const char *file, char *value, const size_t len)
+{
+    char file_path[PATH_MAX];
+    snprintf(file_path, PATH_MAX, POWERCAP_PATH "/%s/%s", zone, file);
+
+    FILE *fp = fopen(file_path, "r");
+    if (fp == NULL)
+        return -errno;
+
+    const int ret = (fgets(value, len, fp) != NULL) ? 0 : -EIO;
+    fclose(fp);
+
+    value[strcspn(value, "\n")] = '\0';
+
+    return ret;
+}
+
+/**
+ * Read the counter of a powercap zone and unroll its wraparound, so the raw
+ * value is a 64-bit counter in microjoules
+ *
+ * @param   zone[inout]       Zone structure
+ * @param   energy_raw[inout] Raw value of the domain
+ * @return  0 on success, a negative error code otherwise
+ */
+static int _rapl_powercap_read_zone(RaplZone_t *zone, uint64_t *energy_raw)
+{
+    char value[32];
+
+    /* The file stays opened, the kernel reads the counter again at offset 0 */
+    const ssize_t len = pread(zone->fd, value, sizeof(value) - 1, 0);
+    if (len < 0)
+        return -errno;
+    if (len == 0)
+        return -EIO;
+
+    value[len] = '\0';
+    _rapl_unroll(zone, strtoull(value, NULL, 10), energy_raw);
+
+    return 0;
+}
+
+/**
+ * Open the counter of a powercap zone
+ *
+ * @param   name[in]    Name of the zone directory
+ * @param   zone[out]   Zone structure
+ * @param   energy_raw[out] Raw value of the domain
+ * @return  0 on success, a negative error code otherwise
+ */
+static int _rapl_powercap_open_zone(const char *name, RaplZone_t *zone, uint64_t *energy_raw)
+{
+    char file_path[PATH_MAX];
+    char value[32];
+
+    int ret = _rapl_powercap_read(name, "max_energy_range_uj", value, sizeof(value));
+    if (ret != 0)
+        return ret;
+
+    snprintf(file_path, PATH_MAX, POWERCAP_PATH "/%s/energy_uj", name);
+    zone->fd = open(file_path, O_RDONLY | O_CLOEXEC);
+    if (zone->fd < 0)
+        return -errno;
+
+    /* The power of the zone is not known */
+    zone->max_value = strtoull(value, NULL, 10);
+    zone->last_value = 0;
+    zone->wrap_period_ns = _rapl_wrap_period_ns((zone->max_value + 1) * 1E-6, RAPL_POWER_DEFAULT);
+    *energy_raw = 0;
+
+    ret = _rapl_powercap_read_zone(zone, energy_raw);
+    if (ret != 0)
+    {
+        close(zone->fd);
+        zone->fd = -1;
+    }
+
+    return ret;
+}
+
+/**
+ * Find the zones of every package in the powercap framework. A package
+ * zone is named <type>:<zone> and its subzones <type>:<zone>:<subzone>.
+ *
+ * @return  0 on success, a negative error code otherwise
+ */
+static int _rapl_powercap_open(void)
+{
+    DIR *dir = opendir(POWERCAP_PATH);
+    if (dir == NULL)
+        return -errno;
+
+    for (uint32_t i = 0; i < _rapl_n_packages; i++)
+        for (int domain = 0; domain < RAPL_DOMAINS_MAX; domain++)
+        {
+            _rapl_packages[i]->zones[domain].fd = -1;
+            _rapl_packages[i]->is_available[domain] = false;
+            _rapl_packages[i]->energy_resolution[domain] = 1E-6;
+        }
+
+    int ret = -ENODEV;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        char parent[NAME_MAX + 1];
+        char name[64];
+        uint32_t package_id = 0;
+        int domain;
+
+        if (strncmp(entry->d_name, "intel-rapl:", 11) != 0 && strncmp(entry->d_name, "amd-rapl:", 9) != 0)
+            continue;
+
+        strncpy(parent, entry->d_name, NAME_MAX);
+        parent[NAME_MAX] = '\0';
+        char *subzone = strchr(strchr(parent, ':') + 1, ':');
+        if (subzone != NULL)
+            *subzone = '\0';
+
+        if (_rapl_powercap_read(parent, "name", name, sizeof(name)) != 0)
+            continue;
+
+        /* The platform zone is not attached to a package */
+        if (strcmp(name, _rapl_zone_str[RAPL_PSYS]) != 0 && sscanf(name, "package-%u", &package_id) != 1)
+            continue;
+
+        if (subzone == NULL)
+            domain = (strcmp(name, _rapl_zone_str[RAPL_PSYS]) == 0) ? RAPL_PSYS : RAPL_PKG;
+        else
+        {
+            if (_rapl_powercap_read(entry->d_name, "name", name, sizeof(name)) != 0)
+                continue;
+
+            for (domain = 0; domain < RAPL_DOMAINS_MAX; domain++)
+                if (strcmp(name, _rapl_zone_str[domain]) == 0)
+                    break;
+        }
+
+        /* Only the first die of a package is used */
+        if (domain == RAPL_DOMAINS_MAX || package_id >= _rapl_n_packages ||
+            _rapl_packages[package_id]->is_available[domain])
+            continue;
+
+        RaplPackage_t *package = _rapl_packages[package_id];
+        int zone_ret = _rapl_powercap_open_zone(entry->d_name, &package->zones[domain],
+                                                &package->sample.energy_raw[domain]);
+        if (zone_ret != 0)
+        {
+            fprintf(stderr, "Unable to open powercap zone %s: %s\n", entry->d_name, strerror(-zone_ret));
+            continue;
+        }
+
+        package->is_available[domain] = true;
+        ret = 0;
+    }
+
+    closedir(dir);
+
+    return ret;
+}
+
+/**
+ * Read a file of the power PMU
+ *
+ * @param   file[in]    Path relative to the PMU directory
+ * @param   value[out]  First line of the file
+ * @param   len[in]     Size of the value buffer
+ * @return  0 on success, a negative error code otherwise
+ */
+static int _rapl_perf_read(const char *file, char *value, const size_t len)
+{
+    char file_path[PATH_MAX];
+    snprintf(file_path, PATH_MAX, PERF_PMU_PATH "/%s", file);
+
+    FILE *fp = fopen(file_path, "r");
+    if (fp == NULL)
+        return -errno;
+
+    const int ret = (fgets(value, len, fp) != NULL) ? 0 : -EIO;
+    fclose(fp);
+
+    return ret;
+}
+
+/**
+ * Open one group of events of the power PMU per package, the counters of
+ * all domains of a package are then read with a single read()
+ *
+ * @return  0 on success, a negative error code otherwise
+ */
+static int _rapl_perf_open(void)
+{
+    char value[64];
+    uint32_t type;
+    uint64_t configs[RAPL_DOMAINS_MAX] = { 0 };
+    double scales[RAPL_DOMAINS_MAX] = { 0 };
+
+    int ret = _rapl_perf_read("type", value, sizeof(value));
+    if (ret != 0)
+        return ret;
+    type = strtoul(value, NULL, 10);
+
+    /* Events are described as event=<config>, the scale is in Joules */
+    for (int domain = 0; domain < RAPL_DOMAINS_MAX; domain++)
+    {
+        char file[64];
+
+        snprintf(file, sizeof(file), "events/%s", _rapl_event_str[domain]);
+        if (_rapl_perf_read(file, value, sizeof(value)) != 0 ||
+            sscanf(value, "event=%lx", &configs[domain]) != 1)
+            continue;
+
+        snprintf(file, sizeof(file), "events/%s.scale", _rapl_event_str[domain]);
+        if (_rapl_perf_read(file, value, sizeof(value)) == 0)
+            scales[domain] = strtod(value, NULL);
+
+        /* Counts of 2^-32 J round in the fixed-point energy scales, counts
+         * of 2^-26 J do not. The cumulated count is shifted, so nothing is lost. */
+        int exponent;
+        _rapl_perf_shifts[domain] = 0;
+        if (frexp(scales[domain], &exponent) == 0.5 && exponent - 1 < -RAPL_PERF_EXACT_BITS)
+        {
+            _rapl_perf_shifts[domain] = -RAPL_PERF_EXACT_BITS - (exponent - 1);
+            scales[domain] = ldexp(scales[domain], _rapl_perf_shifts[domain]);
+        }
+    }
+
+    ret = -ENODEV;
+    uint32_t n_groups = 0;
+    for (uint32_t i = 0; i < _rapl_n_packages; i++)
+    {
+        RaplPackage_t *package = _rapl_packages[i];
+
+        package->group_fd = -1;
+        package->n_events = 0;
+
+        for (int domain = 0; domain < RAPL_DOMAINS_MAX; domain++)
+        {
+            struct perf_event_attr attr = {
+                .type        = type,
+                .size        = sizeof(struct perf_event_attr),
+                .config      = configs[domain],
+                .read_format = PERF_FORMAT_GROUP,
+            };
+
+            package->zones[domain].fd = -1;
+            package->is_available[domain] = false;
+            package->energy_resolution[domain] = scales[domain];
+
+            if (scales[domain] == 0 || package->core_id == TOPOLOGY_NO_CPU)
+                continue;
+
+            const int fd = syscall(SYS_perf_event_open, &attr, -1, package->core_id, package->group_fd,
+                                   PERF_FLAG_FD_CLOEXEC);
+            if (fd < 0)
+            {
+                ret = -errno;
+                continue;
+            }
+
+            if (package->group_fd < 0)
+                package->group_fd = fd;
+
+            /* Counts are 64-bit wide, the kernel handles the wraparound */
+            package->zones[domain].fd = fd;
+            package->zones[domain].wrap_period_ns = UINT64_MAX;
+            package->events[package->n_events++] = domain;
+            package->is_available[domain] = true;
+        }
+
+        n_groups += (package->group_fd >= 0);
+    }
+
+    /* Packages without a group keep their domains unavailable */
+    return (n_groups > 0) ? 0 : ret;
+}
+
+/**
+ * Read the group of events of a package
+ *
+ * @param   package[inout]  Package structure
+ */
+static void _rapl_perf_burst(RaplPackage_t *package)
+{
+    RaplSample_t *sample = &package->sample;
+    uint64_t values[1 + RAPL_DOMAINS_MAX];     /* Amount of events, then their counts */
+    int status = 0;
+
+    const ssize_t len = read(package->group_fd, values, sizeof(values));
+    if (len < 0)
+        status = -errno;
+    else if ((size_t)len < (1 + package->n_events) * sizeof(uint64_t))
+        status = -EIO;
+
+    for (uint32_t i = 0; i < package->n_events; i++)
+    {
+        const int domain = package->events[i];
+
+        sample->status[domain] = status;
+        if (status == 0)
+            sample->energy_raw[domain] = values[1 + i] >> _rapl_perf_shifts[domain];
+    }
+}
+
+/**
+ * Return an upper bound of the power of a domain, from the maximum power
+ * or the thermal spec power of its power info MSR
+ *
+ * @param   package[in]   Package structure
+ * @param   domain[in]    RAPL domain
+ * @param   msr_unit[in]  Content of the power unit MSR
+ * @return  Power in Watts
+ */
+static double _rapl_msr_max_power(const RaplPackage_t *package, const int domain, const uint64_t msr_unit)
+{
+    const uint32_t msr = (domain == RAPL_DRAM) ? MSR_INTEL_DRAM_POWER_INFO : MSR_INTEL_PACKAGE_POWER_INFO;
+    uint64_t power_info;
+
+    /* The platform is not bounded by the power of a package */
+    if (_rapl_vendor != INTEL || domain == RAPL_PSYS || msr_read(package->core_id, msr, &power_info) != 0)
+        return RAPL_POWER_DEFAULT;
+
+    uint64_t power = (power_info >> 32) & MSR_POWER_INFO_MASK;
+    if (power == 0)
+        power = power_info & MSR_POWER_INFO_MASK;
+    if (power == 0)
+        return RAPL_POWER_DEFAULT;
+
+    return RAPL_POWER_MARGIN * power * pow(0.5, (double)(msr_unit & MSR_POWER_UNIT_MASK));
+}
+
+/**
+ * Open the MSR device file of every package, find the available domains
+ * and read their energy units
+ *
+ * @param   model[in]   CPU model
+ * @return  0 on success, a negative error code otherwise
+ */
+static int _rapl_msr_open(const uint32_t model)
+{
+    for (uint32_t i = 0; i < _rapl_n_packages; i++)
+    {
+        RaplPackage_t *package = _rapl_packages[i];
+
+        /* No CPU of the package is online */
+        if (package->core_id == TOPOLOGY_NO_CPU)
+            continue;
+
+        /* Keep the MSR device file opened for the lifetime of the daemon */
+        int ret = msr_open(package->core_id);
+        if (ret == 0)
+        {
+            uint64_t msr_unit;
+            ret = msr_read(package->core_id,
+                           (_rapl_vendor == INTEL) ? MSR_INTEL_POWER_UNIT : MSR_AMD_POWER_UNIT, &msr_unit);
+
+            for (int domain = 0; ret == 0 && domain < RAPL_DOMAINS_MAX; domain++)
+            {
+                const uint32_t msr = _rapl_msr[_rapl_vendor][domain];
+                uint64_t energy_raw;
+
+                /* A domain which is not implemented cannot be read or stays at 0 */
+                package->is_available[domain] = (msr != 0 && msr_read(package->core_id, msr, &energy_raw) == 0 &&
+                                                 energy_raw != 0);
+                if (!package->is_available[domain])
+                    continue;
+
+                RaplZone_t *zone = &package->zones[domain];
+                package->energy_resolution[domain] = _rapl_energy_resolution(model, domain, msr_unit);
+                package->sample.energy_raw[domain] = energy_raw & UINT32_MAX;
+
+                /* RAPL energy counters are 32-bit wide */
+                zone->max_value = UINT32_MAX;
+                zone->last_value = energy_raw & UINT32_MAX;
+                zone->wrap_period_ns = _rapl_wrap_period_ns((UINT32_MAX + 1.0) * package->energy_resolution[domain],
+                                                            _rapl_msr_max_power(package, domain, msr_unit));
+            }
+        }
+
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to read the MSRs of CPU %u: %s\n", package->core_id, strerror(-ret));
+            for (uint32_t j = 0; j <= i; j++)
+                msr_close(_rapl_packages[j]->core_id);
+            return ret;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Read all enabled domains of a package in one burst
+ *
+ * @param   package[inout]  Package structure
+ * @param   tick[in]        Scheduler round of the burst
+ */
+static void _rapl_package_burst(RaplPackage_t *package, const uint64_t tick)
+{
+    RaplSample_t *sample = &package->sample;
+
+    sample->tick = tick;
+    sample->timestamp = get_time_ns();
+
+    /* All domains of the group are counted, only the enabled ones are used */
+    if (_rapl_backend == RAPL_BACKEND_PERF)
+    {
+        _rapl_perf_burst(package);
+        return;
+    }
+
+    for (int domain = 0; domain < RAPL_DOMAINS_MAX; domain++)
+    {
+        if (!_rapl_is_enabled[domain] || !package->is_available[domain])
+            continue;
+
+        if (_rapl_backend == RAPL_BACKEND_POWERCAP)
+        {
+            sample->status[domain] = _rapl_powercap_read_zone(&package->zones[domain],
+                                                              &sample->energy_raw[domain]);
+            continue;
+        }
+
+        uint64_t energy_raw;
+        sample->status[domain] = msr_read(package->core_id, _rapl_msr[_rapl_vendor][domain], &energy_raw);
+        if (sample->status[domain] == 0)
+            _rapl_unroll(&package->zones[domain], energy_raw & UINT32_MAX, &sample->energy_raw[domain]);
+    }
+}
+
+/**
+ * Return the CPU reading a package: its housekeeping CPU if one is online,
+ * else the first online CPU of the package
+ *
+ * @param   package_id[in]  Package id
+ * @return  Id of the CPU, TOPOLOGY_NO_CPU if the package has no online CPU
+ */
+static uint32_t _rapl_reader(const uint32_t package_id)
+{
+    uint32_t cpu_package;
+
+    for (uint32_t i = 0; i < _rapl_n_thread_cpus; i++)
+        if (topology_package(_rapl_thread_cpus[i], &cpu_package) == 0 && cpu_package == package_id)
+            return _rapl_thread_cpus[i];
+
+    return topology_package_reader(package_id);
+}
+
+/**
+ * Read the counters of a package on each burst, from its housekeeping CPU,
+ * until the sampler stops. The package is first moved to memory allocated
+ * by this thread, hence local to its NUMA node.
+ *
+ * @param   arg[in]   Index of the package
+ */
+static void *_rapl_thread(void *arg)
+{
+    const uint32_t i = (uint32_t)(uintptr_t)arg;
+
+    /* Pages are placed on the node of the first CPU touching them */
+    RaplPackage_t *package = malloc(sizeof(RaplPackage_t));
+    if (package != NULL)
+    {
+        memcpy(package, _rapl_packages[i], sizeof(RaplPackage_t));
+        free(_rapl_packages[i]);
+        _rapl_packages[i] = package;
+    }
+    package = _rapl_packages[i];
+    pthread_barrier_wait(&_rapl_done);
+
+    while (true)
+    {
+        pthread_barrier_wait(&_rapl_start);
+        if (_rapl_is_stopping)
+            break;
+
+        _rapl_package_burst(package, _rapl_burst_tick);
+        pthread_barrier_wait(&_rapl_done);
+    }
+
+    return NULL;
+}
+
+/**
+ * Start one sampler thread per package, pinned to the CPU reading the package
+ *
+ * @return  0 on success, a negative error code otherwise
+ */
+static int _rapl_start_threads(void)
+{
+    pthread_attr_t attr;
+    cpu_set_t cpus;
+
+    _rapl_threads = calloc(_rapl_n_packages, sizeof(pthread_t));
+    if (_rapl_threads == NULL)
+        return -ENOMEM;
+
+    pthread_barrier_init(&_rapl_start, NULL, _rapl_n_packages + 1);
+    pthread_barrier_init(&_rapl_done, NULL, _rapl_n_packages + 1);
+    pthread_attr_init(&attr);
+
+    for (; _rapl_n_threads < _rapl_n_packages; _rapl_n_threads++)
+    {
+        CPU_ZERO(&cpus);
+        if (_rapl_packages[_rapl_n_threads]->core_id != TOPOLOGY_NO_CPU)
+            CPU_SET(_rapl_packages[_rapl_n_threads]->core_id, &cpus);
+        else
+            sched_getaffinity(0, sizeof(cpu_set_t), &cpus);
+        pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpus);
+
+        int ret = pthread_create(&_rapl_threads[_rapl_n_threads], &attr, _rapl_thread,
+                                 (void *)(uintptr_t)_rapl_n_threads);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to start the sampler thread of package %u: %s\n",
+                    _rapl_n_threads, strerror(ret));
+            pthread_attr_destroy(&attr);
+            return -ret;
+        }
+    }
+
+    pthread_attr_destroy(&attr);
+
+    /* Packages are moved once all threads run */
+    pthread_barrier_wait(&_rapl_done);
+
+    return 0;
+}
+
+/**
+ * Read the counters of each package from a sampler thread pinned to a
+ * housekeeping CPU of the package, so the MSR reads are local. Must be
+ * called before rapl_init().
+ *
+ * @param   cpus[in]    Comma-separated housekeeping CPUs, at most one per
+ *                      package (NULL: the default reader of each package)
+ * @return  0 on success, -EINVAL if the list is invalid
+ */
+int rapl_set_threads(const char *cpus)
+{
+    _rapl_is_threaded = true;
+    _rapl_n_thread_cpus = 0;
+
+    while (cpus != NULL && *cpus != '\0')
+    {
+        char *end;
+        errno = 0;
+        const unsigned long cpu = strtoul(cpus, &end, 10);
+
+        if (end == cpus || errno != 0 || cpu > UINT32_MAX || (*end != ',' && *end != '\0') ||
+            _rapl_n_thread_cpus == RAPL_THREAD_CPUS_MAX)
+            return -EINVAL;
+
+        _rapl_thread_cpus[_rapl_n_thread_cpus++] = cpu;
+        cpus = (*end == ',') ? end + 1 : end;
+    }
+
+    return 0;
+}
+
+/**
+ * Select the backend used by rapl_init()
+ *
+ * @param   backend[in] RAPL backend
+ */
+void rapl_set_backend(const int backend)
+{
+    _rapl_backend = backend;
+}
+
+/**
+ * Initialize the sampler: map each package to a core, open the counters of
+ * the backend, find the available domains and read their energy units.
+ * Without a requested backend, the MSRs are used, then the power PMU and
+ * last the powercap framework. Subsequent calls only take a reference.
+ *
+ * @param   vendor[in]  CPU vendor
+ * @return  0 on success, a negative error code otherwise
+ */
+int rapl_init(const int vendor)
+{
+    if (_rapl_n_refs++ > 0)
+        return 0;
+
+    if (vendor != INTEL && vendor != AMD)
+        return -ENODEV;
+
+    _rapl_vendor = vendor;
+    const uint32_t model = get_model();
+
+    for (uint32_t i = 0; i < _rapl_n_thread_cpus; i++)
+    {
+        uint32_t package_id;
+        if (topology_package(_rapl_thread_cpus[i], &package_id) != 0)
+        {
+            fprintf(stderr, "Housekeeping CPU %u is not online\n", _rapl_thread_cpus[i]);
+            return -EINVAL;
+        }
+    }
+
+    /* Each package is read by one of its online CPUs */
+    _rapl_packages = calloc(MAX(topology_n_packages(), 1), sizeof(RaplPackage_t *));
+    if (_rapl_packages == NULL)
+        return -ENOMEM;
+
+    for (; _rapl_n_packages < topology_n_packages(); _rapl_n_packages++)
+    {
+        _rapl_packages[_rapl_n_packages] = calloc(1, sizeof(RaplPackage_t));
+        if (_rapl_packages[_rapl_n_packages] == NULL)
+            return -ENOMEM;
+
+        _rapl_packages[_rapl_n_packages]->core_id = _rapl_reader(_rapl_n_packages);
+    }
+
+    for (uint32_t i = 0; i < _rapl_n_packages; i++)
+        _rapl_packages[i]->sample.tick = RAPL_NO_TICK;
+
+    static const int backends[] = { RAPL_BACKEND_MSR, RAPL_BACKEND_PERF, RAPL_BACKEND_POWERCAP };
+    const int requested = _rapl_backend;
+    int ret = -ENODEV;
+
+    for (uint32_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++)
+    {
+        if (requested != RAPL_BACKEND_AUTO && requested != backends[i])
+            continue;
+
+        _rapl_backend = backends[i];
+        if (_rapl_backend == RAPL_BACKEND_MSR)
+            ret = _rapl_msr_open(model);
+        else if (_rapl_backend == RAPL_BACKEND_PERF)
+            ret = _rapl_perf_open();
+        else
+            ret = _rapl_powercap_open();
+
+        if (ret == 0)
+            break;
+
+        fprintf(stderr, "Unable to use the %s backend for RAPL energy counters: %s\n",
+                rapl_backend_str[_rapl_backend], strerror(-ret));
+    }
+
+    if (ret == 0 && _rapl_backend != RAPL_BACKEND_MSR)
+        fprintf(stderr, "Reading RAPL energy counters with the %s backend\n", rapl_backend_str[_rapl_backend]);
+
+    if (ret == 0 && _rapl_is_threaded)
+        ret = _rapl_start_threads();
+
+    return ret;
+}
+
+/**
+ * Release a reference on the sampler and close the MSR device files
+ */
+void rapl_fini(void)
+{
+    if (_rapl_n_refs == 0 || --_rapl_n_refs > 0)
+        return;
+
+    if (_rapl_n_threads > 0)
+    {
+        _rapl_is_stopping = true;
+        pthread_barrier_wait(&_rapl_start);
+
+        for (uint32_t i = 0; i < _rapl_n_threads; i++)
+            pthread_join(_rapl_threads[i], NULL);
+
+        pthread_barrier_destroy(&_rapl_start);
+        pthread_barrier_destroy(&_rapl_done);
+        free(_rapl_threads);
+        _rapl_threads = NULL;
+        _rapl_n_threads = 0;
+        _rapl_is_stopping = false;
+    }
+
+    for (uint32_t i = 0; i < _rapl_n_packages; i++)
+    {
+        if (_rapl_backend == RAPL_BACKEND_MSR)
+            msr_close(_rapl_packages[i]->core_id);
+        else
+            for (int domain = 0; domain < RAPL_DOMAINS_MAX; domain++)
+                if (_rapl_packages[i]->zones[domain].fd >= 0)
+                    close(_rapl_packages[i]->zones[domain].fd);
+    }
+
+    for (uint32_t i = 0; i < _rapl_n_packages; i++)
+        free(_rapl_packages[i]);
+    free(_rapl_packages);
+    _rapl_packages = NULL;
+    _rapl_n_packages = 0;
+}
+
+/**
+ * Add a domain to the burst of the packages where it is available
+ *
+ * @param   domain[in]  RAPL domain
+ * @return  0 on success, -ENODEV if no package has this domain
+ */
+int rapl_enable(const int domain)
+{
+    bool is_available = false;
+
+    for (uint32_t i = 0; i < _rapl_n_packages; i++)
+        is_available |= _rapl_packages[i]->is_available[domain];
+
+    if (!is_available)
+        return -ENODEV;
+
+    _rapl_is_enabled[domain] = true;
+
+    /* Next call must read the new domain */
+    for (uint32_t i = 0; i < _rapl_n_packages; i++)
+        _rapl_packages[i]->sample.tick = RAPL_NO_TICK;
+
+    return 0;
+}
+
+/**
+ * Move the reader of each package to one of its online CPUs, after a CPU
+ * went online or offline. Only the MSRs and the sampler threads are bound to
+ * a CPU, the kernel moves the perf events and the powercap zones itself.
+ */
+void rapl_remap(void)
+{
+    cpu_set_t cpus;
+
+    for (uint32_t i = 0; i < _rapl_n_packages; i++)
+    {
+        RaplPackage_t *package = _rapl_packages[i];
+        const uint32_t core_id = _rapl_reader(i);
+
+        if (core_id == package->core_id)
+            continue;
+
+        if (_rapl_backend == RAPL_BACKEND_MSR)
+        {
+            int ret = (core_id != TOPOLOGY_NO_CPU) ? msr_open(core_id) : 0;
+            if (ret != 0)
+            {
+                fprintf(stderr, "Unable to open MSR file of CPU %u: %s\n", core_id, strerror(-ret));
+                continue;
+            }
+            msr_close(package->core_id);
+        }
+
+        if (_rapl_n_threads > 0 && core_id != TOPOLOGY_NO_CPU)
+        {
+            CPU_ZERO(&cpus);
+            CPU_SET(core_id, &cpus);
+            pthread_setaffinity_np(_rapl_threads[i], sizeof(cpu_set_t), &cpus);
+        }
+
+        /* Counters of a package without online CPU keep their last value */
+        package->core_id = core_id;
+    }
+}
+
+/**
+ * Return the amount of CPU packages
+ */
+uint32_t rapl_n_packages(void)
+{
+    return _rapl_n_packages;
+}
+
+/**
+ * Return the shortest time for a counter of an enabled domain to wrap. The
+ * counters must be read more often so no wraparound is missed.
+ *
+ * @return  Period in nanoseconds, UINT64_MAX if the counters do not wrap
+ */
+uint64_t rapl_wrap_period_ns(void)
+{
+    uint64_t wrap_period_ns = UINT64_MAX;
+
+    for (uint32_t i = 0; i < _rapl_n_packages; i++)
+        for (int domain = 0; domain < RAPL_DOMAINS_MAX; domain++)
+            if (_rapl_is_enabled[domain] && _rapl_packages[i]->is_available[domain])
+                wrap_period_ns = MIN(wrap_period_ns, _rapl_packages[i]->zones[domain].wrap_period_ns);
+
+    return wrap_period_ns;
+}
+
+/**
+ * Read every package without publishing, so the counters are unrolled
+ * between two collections longer than their wrap period
+ *
+ * @param   tick[in]    Current scheduler round
+ */
+void rapl_refresh(const uint64_t tick)
+{
+    for (uint32_t i = 0; i < _rapl_n_packages; i++)
+        rapl_sample(i, tick);
+}
+
+/**
+ * Check whether a domain was found on a package
+ *
+ * @param   package[in] Package id
+ * @param   domain[in]  RAPL domain
+ */
+bool rapl_is_available(const uint32_t package, const int domain)
+{
+    return _rapl_packages[package]->is_available[domain];
+}
+
+/**
+ * Return the energy resolution of a domain in Joules per raw unit
+ *
+ * @param   package[in] Package id
+ * @param   domain[in]  RAPL domain
+ */
+double rapl_energy_resolution(const uint32_t package, const int domain)
+{
+    return _rapl_packages[package]->energy_resolution[domain];
+}
+
+/**
+ * Return the burst of a package for the current scheduler round. All
+ * enabled domains are read once per round, whatever the amount of callers.
+ *
+ * @param   package[in] Package id
+ * @param   tick[in]    Current scheduler round
+ * @return  The latest burst, check the status of each domain before use
+ */
+const RaplSample_t *rapl_sample(const uint32_t package, const uint64_t tick)
+{
+    RaplPackage_t *rapl_package = _rapl_packages[package];
+
+    if (rapl_package->sample.tick == tick)
+        return &rapl_package->sample;
+
+    /* Sampler threads read all packages at the same time */
+    if (_rapl_n_threads > 0)
+    {
+        _rapl_burst_tick = tick;
+        pthread_barrier_wait(&_rapl_start);
+        pthread_barrier_wait(&_rapl_done);
+    }
+    else
+        _rapl_package_burst(rapl_package, tick);
+
+    return &rapl_package->sample;
+}
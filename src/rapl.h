@@ -0,0 +1,90 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* EnergyCounter: Fetch and expose energy counters.
+* rapl.h: Per-package sampler for RAPL energy counters.
+*
+* URL       https://github.com/HewlettPackard/EnergyCounter
+******************************************************************************/
+
+#ifndef RAPL_H
+#define RAPL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+enum rapl_domain {
+    RAPL_PKG,
+    RAPL_DRAM,
+    RAPL_PP0,
+    RAPL_PP1,
+    RAPL_PSYS,
+    RAPL_DOMAINS_MAX
+};
+
+static const char * const rapl_domain_str[] =
+{
+    [RAPL_PKG]  = "package",
+    [RAPL_DRAM] = "dram",
+    [RAPL_PP0]  = "pp0",
+    [RAPL_PP1]  = "pp1",
+    [RAPL_PSYS] = "psys",
+};
+
+enum rapl_backend {
+    RAPL_BACKEND_AUTO,
+    RAPL_BACKEND_MSR,
+    RAPL_BACKEND_POWERCAP,
+    RAPL_BACKEND_PERF,
+    RAPL_BACKENDS_MAX
+};
+
+static const char * const rapl_backend_str[] =
+{
+    [RAPL_BACKEND_AUTO]     = "auto",
+    [RAPL_BACKEND_MSR]      = "msr",
+    [RAPL_BACKEND_POWERCAP] = "powercap",
+    [RAPL_BACKEND_PERF]     = "perf",
+};
+
+typedef struct RaplSample
+{
+    uint64_t tick;                            /* Scheduler round of the burst     */
+    uint64_t timestamp;                       /* Time of the burst (ns)           */
+    uint64_t energy_raw[RAPL_DOMAINS_MAX];    /* Raw counters of enabled domains,
+                                                 unrolled in 64 bits              */
+    int      status[RAPL_DOMAINS_MAX];        /* 0 or negative error code         */
+} RaplSample_t;
+
+void rapl_set_backend(const int backend);
+int rapl_set_threads(const char *cpus);
+int rapl_init(const int vendor);
+void rapl_fini(void);
+void rapl_remap(void);
+int rapl_enable(const int domain);
+uint32_t rapl_n_packages(void);
+uint64_t rapl_wrap_period_ns(void);
+void rapl_refresh(const uint64_t tick);
+bool rapl_is_available(const uint32_t package, const int domain);
+double rapl_energy_resolution(const uint32_t package, const int domain);
+const RaplSample_t *rapl_sample(const uint32_t package, const uint64_t tick);
+
+#endif /* RAPL_H */
@@ -0,0 +1,271 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* EnergyCounter: Fetch and expose energy counters.
+* rollup.c: Downsampled energy and power of every unit at several resolutions.
+*           Buckets are updated incrementally as samples arrive and each
+*           level is a fixed ring, so a week of history takes a constant
+*           71 KiB per unit (2268 buckets of 32 bytes).
+*
+* URL       https://github.com/HewlettPackard/EnergyCounter
+******************************************************************************/
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "interface.h"
+#include "common.h"
+#include "rollup.h"
+
+typedef struct RollupRing
+{
+    RollupBucket_t *buckets;
+    uint32_t        head;           /* Index of the current bucket            */
+    uint32_t        n_buckets;
+} RollupRing_t;
+
+typedef struct Rollup
+{
+    RollupRing_t    rings[ROLLUP_LEVELS_MAX];
+    uint64_t        last_timestamp;
+    uint64_t        last_energy_acc_uj;
+} Rollup_t;
+
+/* Width and amount of buckets of each level: 5 minutes of 1s buckets,
+ * 1 hour of 10s buckets, 1 day of 1m buckets and 1 week of 1h buckets */
+static const uint64_t _rollup_width[ROLLUP_LEVELS_MAX] =
+{
+    [ROLLUP_1S]  = 1 * NS_PER_S,
+    [ROLLUP_10S] = 10 * NS_PER_S,
+    [ROLLUP_1M]  = 60 * NS_PER_S,
+    [ROLLUP_1H]  = 3600 * NS_PER_S,
+};
+
+static const uint32_t _rollup_capacity[ROLLUP_LEVELS_MAX] =
+{
+    [ROLLUP_1S]  = 300,
+    [ROLLUP_10S] = 360,
+    [ROLLUP_1M]  = ROLLUP_BUCKETS_MAX,
+    [ROLLUP_1H]  = 168,
+};
+
+static const Component_t *_rollup_components = NULL;
+static uint32_t           _rollup_n_components = 0;
+static Rollup_t          *_rollups[INTERFACES_MAX];     /* Indexed like the units */
+
+/**
+ * Account for an interval in the bucket containing its end, a new bucket
+ * replaces the oldest one of the ring
+ *
+ * @param   ring[inout]   Ring of a level
+ * @param   width[in]     Width of the buckets of the level (ns)
+ * @param   capacity[in]  Amount of buckets of the level
+ * @param   timestamp[in] End of the interval (ns)
+ * @param   energy_uj[in] Energy of the interval (uJ)
+ * @param   duration[in]  Duration of the interval (ns)
+ * @param   power[in]     Power of the interval (mW)
+ */
+static void _rollup_add(RollupRing_t *ring, const uint64_t width, const uint32_t capacity,
+                        const uint64_t timestamp, const uint64_t energy_uj,
+                        const uint64_t duration, const uint32_t power)
+{
+    const uint64_t start = timestamp - timestamp % width;
+    RollupBucket_t *bucket = &ring->buckets[ring->head];
+
+    if (ring->n_buckets == 0 || bucket->start != start)
+    {
+        if (ring->n_buckets > 0)
+            ring->head = (ring->head + 1) % capacity;
+        ring->n_buckets = MIN(ring->n_buckets + 1, capacity);
+
+        bucket = &ring->buckets[ring->head];
+        *bucket = (RollupBucket_t) {
+            .start     = start,
+            .min_power = UINT32_MAX,
+        };
+    }
+
+    bucket->energy_uj += energy_uj;
+    bucket->duration += duration;
+    bucket->min_power = MIN(bucket->min_power, power);
+    bucket->max_power = MAX(bucket->max_power, power);
+}
+
+/**
+ * Allocate the rollups of every unit
+ *
+ * @param   components[in]   Array of all components
+ * @param   n_components[in] Amount of components
+ */
+void rollup_init(const Component_t *components, const uint32_t n_components)
+{
+    _rollup_components = components;
+    _rollup_n_components = MIN(n_components, INTERFACES_MAX);
+
+    for (uint32_t i = 0; i < _rollup_n_components; i++)
+    {
+        if (components[i].n_siblings == 0)
+            continue;
+
+        _rollups[i] = calloc(components[i].n_siblings, sizeof(Rollup_t));
+        if (_rollups[i] == NULL)
+        {
+            fprintf(stderr, "Unable to allocate the rollups of %s units\n", interface_str[i]);
+            exit(EXIT_FAILURE);
+        }
+
+        for (uint32_t j = 0; j < components[i].n_siblings; j++)
+        {
+            Rollup_t *rollup = &_rollups[i][j];
+
+            for (int level = 0; level < ROLLUP_LEVELS_MAX; level++)
+            {
+                rollup->rings[level].buckets = calloc(_rollup_capacity[level], sizeof(RollupBucket_t));
+                if (rollup->rings[level].buckets == NULL)
+                {
+                    fprintf(stderr, "Unable to allocate the rollups of %s\n",
+                            components[i].siblings[j].name);
+                    exit(EXIT_FAILURE);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Release the rollups of every unit
+ */
+void rollup_fini(void)
+{
+    for (uint32_t i = 0; i < _rollup_n_components; i++)
+    {
+        if (_rollups[i] == NULL)
+            continue;
+
+        for (uint32_t j = 0; j < _rollup_components[i].n_siblings; j++)
+        {
+            for (int level = 0; level < ROLLUP_LEVELS_MAX; level++)
+                free(_rollups[i][j].rings[level].buckets);
+        }
+
+        free(_rollups[i]);
+        _rollups[i] = NULL;
+    }
+
+    _rollup_components = NULL;
+    _rollup_n_components = 0;
+}
+
+/**
+ * Account for the samples of the components collected during the last round
+ *
+ * @param   components[in]   Array of all components
+ * @param   n_components[in] Amount of components
+ * @param   tick[in]         Scheduler round to record
+ */
+void rollup_record(const Component_t *components, const uint32_t n_components,
+                   const uint64_t tick)
+{
+    if (_rollup_components == NULL)
+        return;
+
+    /* Rollups only exist for the components known at init */
+    const uint32_t n_recorded = MIN(n_components, _rollup_n_components);
+
+    for (uint32_t i = 0; i < n_recorded; i++)
+    {
+        const Component_t *component = &components[i];
+
+        if (component->tick != tick)
+            continue;
+
+        for (uint32_t j = 0; j < component->n_siblings; j++)
+        {
+            const Counters_t *counters = &component->counters;
+            const uint64_t timestamp = counters->timestamp[j];
+            Rollup_t *rollup = &_rollups[i][j];
+            const bool is_first = (rollup->last_timestamp == 0);
+
+            /* The counter could not be read during this round */
+            if (timestamp <= rollup->last_timestamp)
+                continue;
+
+            const uint64_t energy_uj = counters->energy_acc_uj[j] - rollup->last_energy_acc_uj;
+            const uint64_t duration = timestamp - rollup->last_timestamp;
+
+            rollup->last_timestamp = timestamp;
+            rollup->last_energy_acc_uj = counters->energy_acc_uj[j];
+
+            if (is_first)
+                continue;
+
+            const uint64_t power = MIN(get_power_mw(energy_uj, duration), UINT32_MAX);
+
+            for (int level = 0; level < ROLLUP_LEVELS_MAX; level++)
+                _rollup_add(&rollup->rings[level], _rollup_width[level], _rollup_capacity[level],
+                            timestamp, energy_uj, duration, power);
+        }
+    }
+}
+
+/**
+ * Retrieve the last buckets of a unit at a given resolution, the current
+ * bucket being the last one
+ *
+ * @param   name[in]       Name of the unit
+ * @param   level[in]      Resolution of the buckets
+ * @param   n_buckets[in]  Amount of buckets requested
+ * @param   buckets[out]   Buckets in chronological order (n_buckets at most)
+ * @param   n_found[out]   Amount of buckets returned
+ * @return  0 on success, -ENOENT for an unknown unit, -EINVAL for a wrong level
+ */
+int rollup_get(const char *name, const int level, const uint32_t n_buckets,
+               RollupBucket_t *buckets, uint32_t *n_found)
+{
+    const Rollup_t *rollup = NULL;
+
+    if (level < 0 || level >= ROLLUP_LEVELS_MAX)
+        return -EINVAL;
+
+    for (uint32_t i = 0; i < _rollup_n_components && rollup == NULL; i++)
+        for (uint32_t j = 0; j < _rollup_components[i].n_siblings; j++)
+            if (strcmp(_rollup_components[i].siblings[j].name, name) == 0)
+            {
+                rollup = &_rollups[i][j];
+                break;
+            }
+
+    if (rollup == NULL)
+        return -ENOENT;
+
+    const RollupRing_t *ring = &rollup->rings[level];
+    const uint32_t capacity = _rollup_capacity[level];
+    const uint32_t n = MIN(n_buckets, ring->n_buckets);
+
+    for (uint32_t k = 0; k < n; k++)
+        buckets[k] = ring->buckets[(ring->head + capacity + 1 - n + k) % capacity];
+
+    *n_found = n;
+
+    return 0;
+}
@@ -0,0 +1,68 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* EnergyCounter: Fetch and expose energy counters.
+* rollup.h: Downsampled energy and power of every unit at several resolutions.
+*
+* URL       https://github.com/HewlettPackard/EnergyCounter
+******************************************************************************/
+
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+#include <stdint.h>
+#include "interface.h"
+
+#define ROLLUP_BUCKETS_MAX 1440     /* Largest amount of buckets of a level */
+
+enum rollup_level {
+    ROLLUP_1S,
+    ROLLUP_10S,
+    ROLLUP_1M,
+    ROLLUP_1H,
+    ROLLUP_LEVELS_MAX
+};
+
+static const char * const rollup_level_str[] =
+{
+    [ROLLUP_1S]  = "1s",
+    [ROLLUP_10S] = "10s",
+    [ROLLUP_1M]  = "1m",
+    [ROLLUP_1H]  = "1h",
+};
+
+typedef struct RollupBucket
+{
+    uint64_t  start;                /* Beginning of the bucket (monotonic, ns)  */
+    uint64_t  energy_uj;            /* Energy of the intervals ending in it (uJ)*/
+    uint64_t  duration;             /* Duration of these intervals (ns)         */
+    uint32_t  min_power;            /* Lowest power of an interval (mW)         */
+    uint32_t  max_power;            /* Highest power of an interval (mW)        */
+} RollupBucket_t;
+
+void rollup_init(const Component_t *components, const uint32_t n_components);
+void rollup_fini(void);
+void rollup_record(const Component_t *components, const uint32_t n_components,
+                   const uint64_t tick);
+int rollup_get(const char *name, const int level, const uint32_t n_buckets,
+               RollupBucket_t *buckets, uint32_t *n_found);
+
+#endif /* ROLLUP_H */
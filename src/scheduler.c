@@ -0,0 +1,361 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* EnergyCounter: Fetch and expose energy counters.
+* scheduler.c: Multi-rate scheduler based on a min-heap of deadlines. The
+*              daemon waits in an event loop (epoll) on a timer armed with
+*              the earliest deadline, so file descriptors (e.g. query
+*              clients) are served between two rounds without ever delaying
+*              the collection.
+*
+* URL       https://github.com/HewlettPackard/EnergyCounter
+******************************************************************************/
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include "interface.h"
+#include "common.h"
+#include "scheduler.h"
+
+#define SCHED_EVENTS_MAX 16
+
+/**
+ * Move a task up the heap until its parent has an earlier deadline
+ *
+ * @param   sched[inout]  Scheduler structure
+ * @param   i[in]         Position of the task in the heap
+ */
+static void _sched_sift_up(Scheduler_t *sched, uint32_t i)
+{
+    Task_t **heap = sched->heap;
+
+    while (i > 0)
+    {
+        const uint32_t parent = (i - 1) / 2;
+        if (heap[parent]->deadline <= heap[i]->deadline)
+            break;
+
+        Task_t *tmp = heap[parent];
+        heap[parent] = heap[i];
+        heap[i] = tmp;
+        i = parent;
+    }
+}
+
+/**
+ * Move a task down the heap until its children have later deadlines
+ *
+ * @param   sched[inout]  Scheduler structure
+ * @param   i[in]         Position of the task in the heap
+ * @param   n[in]         Amount of tasks in the heap
+ */
+static void _sched_sift_down(Scheduler_t *sched, uint32_t i, const uint32_t n)
+{
+    Task_t **heap = sched->heap;
+
+    while (true)
+    {
+        const uint32_t left = 2 * i + 1;
+        const uint32_t right = left + 1;
+        uint32_t min = i;
+
+        if (left < n && heap[left]->deadline < heap[min]->deadline)
+            min = left;
+        if (right < n && heap[right]->deadline < heap[min]->deadline)
+            min = right;
+        if (min == i)
+            break;
+
+        Task_t *tmp = heap[min];
+        heap[min] = heap[i];
+        heap[i] = tmp;
+        i = min;
+    }
+}
+
+/**
+ * Compute the next deadline of a task and account for the missed ones
+ *
+ * @param   sched[inout]  Scheduler structure
+ * @param   task[inout]   Task which just ran
+ */
+static void _sched_reschedule(Scheduler_t *sched, Task_t *task)
+{
+    const uint64_t now = get_time_ns();
+
+    task->deadline += task->period;
+
+    /* The task took longer than its period, skip the missed deadlines
+     * instead of stretching the period */
+    if (now >= task->deadline)
+    {
+        const uint64_t n_missed = (now - task->deadline) / task->period + 1;
+
+        task->deadline += n_missed * task->period;
+        task->n_overruns += n_missed;
+        sched->n_overruns += n_missed;
+
+        fprintf(stderr, "Warning: %s overrun, %lu deadline(s) missed (total: %lu)\n",
+                task->name, n_missed, task->n_overruns);
+    }
+}
+
+/**
+ * Serve the watched file descriptors until an absolute deadline of the
+ * monotonic clock
+ *
+ * @param   sched[inout]  Scheduler structure
+ * @param   deadline[in]  Absolute deadline (ns)
+ */
+static void _sched_wait_until(Scheduler_t *sched, const uint64_t deadline)
+{
+    const struct itimerspec its = {
+        .it_value = {
+            .tv_sec  = deadline / NS_PER_S,
+            .tv_nsec = deadline % NS_PER_S,
+        },
+    };
+    struct epoll_event events[SCHED_EVENTS_MAX];
+
+    timerfd_settime(sched->timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+
+    while (!sched->is_stopped && get_time_ns() < deadline)
+    {
+        const int n = epoll_wait(sched->epoll_fd, events, SCHED_EVENTS_MAX, -1);
+
+        for (int i = 0; i < n; i++)
+        {
+            /* Timer expired, the loop condition checks the deadline */
+            if (events[i].data.ptr == NULL)
+            {
+                uint64_t n_expirations;
+                (void)!read(sched->timer_fd, &n_expirations, sizeof(n_expirations));
+                continue;
+            }
+
+            Watch_t *watch = events[i].data.ptr;
+            watch->handle(watch->arg, events[i].events);
+        }
+    }
+}
+
+/**
+ * Initialize the scheduler. All periods start from the same origin so tasks
+ * with commensurate periods are due at the same time.
+ *
+ * @param   sched[out]    Scheduler structure
+ */
+void sched_init(Scheduler_t *sched)
+{
+    memset(sched, 0, sizeof(Scheduler_t));
+
+    sched->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    sched->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (sched->epoll_fd < 0 || sched->timer_fd < 0)
+    {
+        fprintf(stderr, "Unable to create the event loop: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    struct epoll_event event = { .events = EPOLLIN, .data.ptr = NULL };
+    if (epoll_ctl(sched->epoll_fd, EPOLL_CTL_ADD, sched->timer_fd, &event) != 0)
+    {
+        fprintf(stderr, "Unable to watch the scheduler timer: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    sched->start = get_time_ns();
+}
+
+/**
+ * Release the event loop
+ *
+ * @param   sched[inout]  Scheduler structure
+ */
+void sched_fini(Scheduler_t *sched)
+{
+    close(sched->timer_fd);
+    close(sched->epoll_fd);
+}
+
+/**
+ * Watch a file descriptor, its handler is called from the event loop
+ *
+ * @param   sched[inout]  Scheduler structure
+ * @param   watch[in]     File descriptor and handler, must stay valid until unwatched
+ * @param   events[in]    Epoll events to watch
+ * @return  0 on success, a negative error code otherwise
+ */
+int sched_watch(Scheduler_t *sched, Watch_t *watch, const uint32_t events)
+{
+    struct epoll_event event = { .events = events, .data.ptr = watch };
+
+    if (epoll_ctl(sched->epoll_fd, EPOLL_CTL_ADD, watch->fd, &event) != 0)
+        return -errno;
+
+    return 0;
+}
+
+/**
+ * Change the events watched on a file descriptor
+ *
+ * @param   sched[inout]  Scheduler structure
+ * @param   watch[in]     Watched file descriptor
+ * @param   events[in]    Epoll events to watch
+ * @return  0 on success, a negative error code otherwise
+ */
+int sched_rewatch(Scheduler_t *sched, Watch_t *watch, const uint32_t events)
+{
+    struct epoll_event event = { .events = events, .data.ptr = watch };
+
+    if (epoll_ctl(sched->epoll_fd, EPOLL_CTL_MOD, watch->fd, &event) != 0)
+        return -errno;
+
+    return 0;
+}
+
+/**
+ * Stop watching a file descriptor
+ *
+ * @param   sched[inout]  Scheduler structure
+ * @param   watch[in]     Watched file descriptor
+ */
+void sched_unwatch(Scheduler_t *sched, Watch_t *watch)
+{
+    epoll_ctl(sched->epoll_fd, EPOLL_CTL_DEL, watch->fd, NULL);
+}
+
+/**
+ * Register a periodic task. The first run happens at the scheduler origin.
+ *
+ * @param   sched[inout]  Scheduler structure
+ * @param   name[in]      Name of the task
+ * @param   period_ns[in] Period between two runs (ns)
+ * @param   run[in]       Function to execute
+ * @param   arg[in]       Argument given to the function
+ * @return  The registered task
+ */
+Task_t *sched_add(Scheduler_t *sched, const char *name, const uint64_t period_ns,
+                  void (*run)(void *), void *arg)
+{
+    if (sched->n_tasks >= SCHED_TASKS_MAX)
+    {
+        fprintf(stderr, "Unable to register task %s: too many tasks\n", name);
+        exit(EXIT_FAILURE);
+    }
+
+    Task_t *task = &sched->tasks[sched->n_tasks];
+    task->name = name;
+    task->period = period_ns;
+    task->deadline = sched->start;
+    task->run = run;
+    task->arg = arg;
+
+    sched->heap[sched->n_tasks] = task;
+    _sched_sift_up(sched, sched->n_tasks);
+    sched->n_tasks++;
+
+    return task;
+}
+
+/**
+ * Stop the event loop: the current wait returns and no task runs anymore.
+ * Called from a watch handler, e.g. on a termination signal.
+ *
+ * @param   sched[inout]  Scheduler structure
+ */
+void sched_stop(Scheduler_t *sched)
+{
+    sched->is_stopped = true;
+}
+
+/**
+ * Return the earliest deadline among all tasks
+ *
+ * @param   sched[in]     Scheduler structure
+ */
+uint64_t sched_next_deadline(const Scheduler_t *sched)
+{
+    return sched->heap[0]->deadline;
+}
+
+/**
+ * Serve the watched file descriptors until the earliest deadline, then run
+ * all the tasks which are due
+ *
+ * @param   sched[inout]  Scheduler structure
+ * @return  Amount of tasks which ran
+ */
+uint32_t sched_run_once(Scheduler_t *sched)
+{
+    Task_t *due[SCHED_TASKS_MAX];
+    uint32_t n_due = 0;
+
+    if (sched->n_tasks == 0)
+        return 0;
+
+    _sched_wait_until(sched, sched_next_deadline(sched));
+    if (sched->is_stopped)
+        return 0;
+
+    sched->n_rounds++;
+
+    /* Pop all tasks which are due */
+    const uint64_t now = get_time_ns();
+    uint32_t n = sched->n_tasks;
+    while (n > 0 && sched->heap[0]->deadline <= now)
+    {
+        due[n_due++] = sched->heap[0];
+        sched->heap[0] = sched->heap[--n];
+        _sched_sift_down(sched, 0, n);
+    }
+
+    /* Run due tasks in registration order, so tasks depending on others
+     * (e.g. overhead evaluation) see the latest values */
+    for (uint32_t i = 1; i < n_due; i++)
+        for (uint32_t j = i; j > 0 && due[j] < due[j - 1]; j--)
+        {
+            Task_t *tmp = due[j];
+            due[j] = due[j - 1];
+            due[j - 1] = tmp;
+        }
+
+    for (uint32_t i = 0; i < n_due; i++)
+        due[i]->run(due[i]->arg);
+
+    /* Push them back with their next deadline */
+    for (uint32_t i = 0; i < n_due; i++)
+    {
+        _sched_reschedule(sched, due[i]);
+        sched->heap[n] = due[i];
+        _sched_sift_up(sched, n);
+        n++;
+    }
+
+    return n_due;
+}
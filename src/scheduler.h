@@ -0,0 +1,79 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* EnergyCounter: Fetch and expose energy counters.
+* scheduler.h: Multi-rate scheduler based on a min-heap of deadlines and
+*              event loop for the file descriptors served next to it.
+*
+* URL       https://github.com/HewlettPackard/EnergyCounter
+******************************************************************************/
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SCHED_TASKS_MAX 32
+
+typedef struct Task
+{
+    const char  *name;                  /* Name used when reporting overruns    */
+    uint64_t     deadline;              /* Next absolute deadline (ns)          */
+    uint64_t     period;                /* Period between two runs (ns)         */
+    uint64_t     n_overruns;            /* Amount of missed deadlines           */
+    void        (*run)(void *arg);
+    void        *arg;
+} Task_t;
+
+typedef struct Watch
+{
+    int          fd;
+    void        (*handle)(void *arg, const uint32_t events);
+    void        *arg;
+} Watch_t;
+
+typedef struct Scheduler
+{
+    Task_t       tasks[SCHED_TASKS_MAX];
+    Task_t      *heap[SCHED_TASKS_MAX]; /* Min-heap of tasks ordered by deadline */
+    uint32_t     n_tasks;
+    uint64_t     start;                 /* Common origin of all periods (ns)     */
+    uint64_t     n_rounds;              /* Amount of rounds, tasks of a same round
+                                           share the same tick                   */
+    uint64_t     n_overruns;            /* Amount of missed deadlines (all tasks) */
+    int          epoll_fd;              /* Event loop                            */
+    int          timer_fd;              /* Armed on the earliest deadline        */
+    bool         is_stopped;            /* Set by sched_stop(), no task runs     */
+} Scheduler_t;
+
+void sched_init(Scheduler_t *sched);
+void sched_fini(Scheduler_t *sched);
+int sched_watch(Scheduler_t *sched, Watch_t *watch, const uint32_t events);
+int sched_rewatch(Scheduler_t *sched, Watch_t *watch, const uint32_t events);
+void sched_unwatch(Scheduler_t *sched, Watch_t *watch);
+Task_t *sched_add(Scheduler_t *sched, const char *name, const uint64_t period_ns,
+                  void (*run)(void *), void *arg);
+uint32_t sched_run_once(Scheduler_t *sched);
+void sched_stop(Scheduler_t *sched);
+uint64_t sched_next_deadline(const Scheduler_t *sched);
+
+#endif /* SCHEDULER_H */
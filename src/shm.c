@@ -0,0 +1,176 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* EnergyCounter: Fetch and expose energy counters.
+* shm.c: Publish all units in a POSIX shared memory segment.
+*
+* URL       https://github.com/HewlettPackard/EnergyCounter
+******************************************************************************/
+
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "interface.h"
+#include "shm.h"
+
+static EcounterShm_t *_shm = NULL;
+static size_t         _shm_size = 0;
+static char           _shm_name[NAME_MAX];
+
+/**
+ * Create the shared memory segment and describe every unit
+ *
+ * @param   name[in]         Name of the POSIX shared memory segment
+ * @param   components[in]   Array of all components
+ * @param   n_components[in] Amount of components
+ * @return  0 on success, a negative error code otherwise
+ */
+int shm_init(const char *name, const Component_t *components, const uint32_t n_components)
+{
+    uint32_t n_units = 0;
+
+    for (uint32_t i = 0; i < n_components; i++)
+        n_units += components[i].n_siblings;
+
+    _shm_size = sizeof(EcounterShm_t) + n_units * sizeof(EcounterShmUnit_t);
+    strncpy(_shm_name, name, NAME_MAX - 1);
+
+    int fd = shm_open(_shm_name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0)
+        return -errno;
+
+    if (ftruncate(fd, _shm_size) != 0)
+    {
+        int ret = -errno;
+        close(fd);
+        return ret;
+    }
+
+    _shm = mmap(NULL, _shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (_shm == MAP_FAILED)
+    {
+        _shm = NULL;
+        return -errno;
+    }
+
+    memset(_shm, 0, _shm_size);
+    _shm->magic = ECOUNTER_SHM_MAGIC;
+    _shm->version = ECOUNTER_SHM_VERSION;
+    _shm->n_units = n_units;
+    _shm->unit_size = sizeof(EcounterShmUnit_t);
+
+    uint32_t k = 0;
+    for (uint32_t i = 0; i < n_components; i++)
+    {
+        const Component_t *component = &components[i];
+
+        for (uint32_t j = 0; j < component->n_siblings; j++, k++)
+        {
+            EcounterShmUnit_t *unit = &_shm->units[k];
+
+            unit->id = component->siblings[j].id;
+            unit->type = component->type;
+            unit->vendor = component->vendor;
+            unit->bus_id = component->siblings[j].bus_id;
+            snprintf(unit->name, sizeof(unit->name), "%s", component->siblings[j].name);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Remove the shared memory segment
+ */
+void shm_fini(void)
+{
+    if (_shm == NULL)
+        return;
+
+    munmap(_shm, _shm_size);
+    shm_unlink(_shm_name);
+    _shm = NULL;
+}
+
+/**
+ * Publish the units of the components collected during the last round
+ *
+ * @param   components[in]   Array of all components
+ * @param   n_components[in] Amount of components
+ * @param   tick[in]         Scheduler round to publish
+ * @param   generation[in]   Generation of this publication
+ */
+void shm_publish(const Component_t *components, const uint32_t n_components,
+                 const uint64_t tick, const uint64_t generation)
+{
+    if (_shm == NULL)
+        return;
+
+    const uint64_t seq = _shm->seq;
+
+    /* Enter the critical section, the fence orders the odd sequence
+     * before the unit updates */
+    __atomic_store_n(&_shm->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    uint32_t k = 0;
+    for (uint32_t i = 0; i < n_components; i++)
+    {
+        const Component_t *component = &components[i];
+
+        if (component->tick != tick)
+        {
+            k += component->n_siblings;
+            continue;
+        }
+
+        for (uint32_t j = 0; j < component->n_siblings; j++, k++)
+        {
+            const Counters_t *src = &component->counters;
+            EcounterShmUnit_t *unit = &_shm->units[k];
+
+            __atomic_store_n(&unit->energy_acc, src->energy_acc[j], __ATOMIC_RELAXED);
+            __atomic_store_n(&unit->energy_interval, src->energy_interval[j], __ATOMIC_RELAXED);
+            __atomic_store_n(&unit->energy_acc_uj, src->energy_acc_uj[j], __ATOMIC_RELAXED);
+            __atomic_store_n(&unit->energy_interval_uj, src->energy_interval_uj[j], __ATOMIC_RELAXED);
+            __atomic_store_n(&unit->timestamp, src->timestamp[j], __ATOMIC_RELAXED);
+            __atomic_store_n(&unit->generation, generation, __ATOMIC_RELAXED);
+        }
+    }
+
+    __atomic_store_n(&_shm->generation, generation, __ATOMIC_RELAXED);
+
+    /* Leave the critical section */
+    __atomic_store_n(&_shm->seq, seq + 2, __ATOMIC_RELEASE);
+
+    /* Wake up the readers blocked in ecounter_shm_wait() */
+    __atomic_add_fetch(&_shm->notify, 1, __ATOMIC_RELEASE);
+    syscall(SYS_futex, &_shm->notify, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
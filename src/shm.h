@@ -0,0 +1,186 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* EnergyCounter: Fetch and expose energy counters.
+* shm.h: Layout of the shared memory counter table. This header is meant
+*        to be included by readers as well.
+*
+* The table is protected by a sequence lock: the writer makes the sequence
+* odd before updating the units and even again afterwards. Readers copy the
+* units and retry if the sequence was odd or changed in the meantime, so all
+* counters can be read with plain loads and no system call:
+*
+*     int fd = shm_open(ECOUNTER_SHM_NAME_DEFAULT, O_RDONLY, 0);
+*     ... mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0) ...
+*     uint64_t seq;
+*     do {
+*         seq = ecounter_shm_read_begin(shm);
+*         for (uint32_t i = 0; i < shm->n_units; i++)
+*             ecounter_shm_read_unit(shm, i, &units[i]);
+*     } while (ecounter_shm_read_retry(shm, seq));
+*
+* Readers can block until the next publication instead of polling:
+*
+*     uint32_t notify = ecounter_shm_notify(shm);
+*     ... read the table ...
+*     ecounter_shm_wait(shm, notify, NULL);
+*
+* URL       https://github.com/HewlettPackard/EnergyCounter
+******************************************************************************/
+
+#ifndef SHM_H
+#define SHM_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#define ECOUNTER_SHM_NAME_DEFAULT  "/ecounter"
+#define ECOUNTER_SHM_MAGIC         0x544e4345  /* "ECNT" */
+#define ECOUNTER_SHM_VERSION       4
+#define ECOUNTER_SHM_NAME_MAX      32
+
+typedef struct EcounterShmUnit
+{
+    uint32_t id;
+    uint32_t type;                 /* enum type in interface.h               */
+    uint32_t vendor;               /* enum vendor in interface.h             */
+    uint32_t reserved;
+    uint64_t bus_id;
+    uint64_t energy_acc;           /* Energy accumulator in Joules           */
+    uint64_t energy_interval;      /* Energy during last interval in Joules  */
+    uint64_t timestamp;            /* Time of the last read (monotonic, ns)  */
+    uint64_t generation;           /* Generation of the last update          */
+    uint64_t energy_acc_uj;        /* Energy accumulator in microjoules      */
+    uint64_t energy_interval_uj;   /* Energy during last interval in microjoules */
+    char     name[ECOUNTER_SHM_NAME_MAX]; /* Unique name of the unit, as its
+                                      output file (e.g. cpu_core_3, cpu_psys_0,
+                                      dram_package_0), set once before the
+                                      first publication */
+} EcounterShmUnit_t;
+
+typedef struct EcounterShm
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t n_units;
+    uint32_t unit_size;            /* sizeof(EcounterShmUnit_t)              */
+    uint64_t seq;                  /* Sequence lock, odd while writing       */
+    uint64_t generation;           /* Incremented on every publication       */
+    uint32_t notify;               /* Futex word, incremented and woken up
+                                      after every publication               */
+    uint32_t reserved;
+    EcounterShmUnit_t units[];
+} EcounterShm_t;
+
+/**
+ * Wait for the writer to leave the critical section and return the sequence
+ *
+ * @param   shm[in]     Mapped counter table
+ */
+static inline uint64_t ecounter_shm_read_begin(const EcounterShm_t *shm)
+{
+    uint64_t seq;
+
+    while ((seq = __atomic_load_n(&shm->seq, __ATOMIC_ACQUIRE)) & 1)
+        __builtin_ia32_pause();
+
+    return seq;
+}
+
+/**
+ * Copy a unit of the table
+ *
+ * @param   shm[in]     Mapped counter table
+ * @param   i[in]       Index of the unit
+ * @param   unit[out]   Copy of the unit
+ */
+static inline void ecounter_shm_read_unit(const EcounterShm_t *shm, const uint32_t i,
+                                          EcounterShmUnit_t *unit)
+{
+    const EcounterShmUnit_t *src = &shm->units[i];
+
+    unit->id              = __atomic_load_n(&src->id, __ATOMIC_RELAXED);
+    unit->type            = __atomic_load_n(&src->type, __ATOMIC_RELAXED);
+    unit->vendor          = __atomic_load_n(&src->vendor, __ATOMIC_RELAXED);
+    unit->reserved        = 0;
+    unit->bus_id          = __atomic_load_n(&src->bus_id, __ATOMIC_RELAXED);
+    unit->energy_acc      = __atomic_load_n(&src->energy_acc, __ATOMIC_RELAXED);
+    unit->energy_interval = __atomic_load_n(&src->energy_interval, __ATOMIC_RELAXED);
+    unit->timestamp       = __atomic_load_n(&src->timestamp, __ATOMIC_RELAXED);
+    unit->generation      = __atomic_load_n(&src->generation, __ATOMIC_RELAXED);
+    unit->energy_acc_uj   = __atomic_load_n(&src->energy_acc_uj, __ATOMIC_RELAXED);
+    unit->energy_interval_uj = __atomic_load_n(&src->energy_interval_uj, __ATOMIC_RELAXED);
+    memcpy(unit->name, src->name, sizeof(unit->name));
+}
+
+/**
+ * Check whether the copies made since ecounter_shm_read_begin() are torn
+ *
+ * @param   shm[in]     Mapped counter table
+ * @param   seq[in]     Sequence returned by ecounter_shm_read_begin()
+ * @return  Non-zero if the copies must be done again
+ */
+static inline int ecounter_shm_read_retry(const EcounterShm_t *shm, const uint64_t seq)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    return __atomic_load_n(&shm->seq, __ATOMIC_RELAXED) != seq;
+}
+
+/**
+ * Return the notification word to pass to ecounter_shm_wait(), it must be
+ * loaded before reading the table so no publication is missed
+ *
+ * @param   shm[in]     Mapped counter table
+ */
+static inline uint32_t ecounter_shm_notify(const EcounterShm_t *shm)
+{
+    return __atomic_load_n(&shm->notify, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Block until a publication happens after ecounter_shm_notify() returned
+ * a given value
+ *
+ * @param   shm[in]       Mapped counter table
+ * @param   notify[in]    Value returned by ecounter_shm_notify()
+ * @param   timeout[in]   Relative timeout (NULL: none)
+ * @return  0 on publication, -ETIMEDOUT or -EINTR otherwise
+ */
+static inline int ecounter_shm_wait(const EcounterShm_t *shm, const uint32_t notify,
+                                    const struct timespec *timeout)
+{
+    while (__atomic_load_n(&shm->notify, __ATOMIC_ACQUIRE) == notify)
+    {
+        if (syscall(SYS_futex, &shm->notify, FUTEX_WAIT, notify, timeout, NULL, 0) != 0 &&
+            (errno == ETIMEDOUT || errno == EINTR))
+            return -errno;
+    }
+
+    return 0;
+}
+
+#endif /* SHM_H */
@@ -0,0 +1,338 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* EnergyCounter: Fetch and expose energy counters.
+* snapshot.c: Consolidated snapshot of all energy counters. The snapshot is
+*             rendered in a temporary file which is atomically renamed, so
+*             readers always get a coherent view of the node in one read.
+*
+* URL       https://github.com/HewlettPackard/EnergyCounter
+******************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/limits.h>
+#include "interface.h"
+#include "common.h"
+#include "buffer.h"
+#include "snapshot.h"
+
+static const char * const _snapshot_file[] =
+{
+    [SNAPSHOT_JSON] = "snapshot.json",
+    [SNAPSHOT_KV]   = "snapshot.kv",
+    [SNAPSHOT_PROM] = "ecounter.prom",
+};
+
+typedef struct Snapshot
+{
+    char      path[PATH_MAX];       /* Final path of the snapshot file     */
+    char      tmp_path[PATH_MAX];   /* Temporary file renamed on update    */
+    bool      is_enabled;
+} Snapshot_t;
+
+static Snapshot_t _snapshots[SNAPSHOT_FORMATS_MAX];
+static Buffer_t   _snapshot_buf = { 0 };
+
+/**
+ * Check whether the units of a component are part of the rendering
+ */
+static inline bool _snapshot_is_selected(const Component_t *component,
+                                         const SnapshotFilter_t *filter)
+{
+    if (filter == NULL)
+        return true;
+
+    if (filter->type != TYPE_UNKNOWN && filter->type != (int)component->type)
+        return false;
+
+    return component->generation > filter->since;
+}
+
+/**
+ * Render the snapshot in JSON
+ */
+static void _snapshot_render_json(Buffer_t *buf, const Component_t *components,
+                                  const uint32_t n_components, const uint64_t generation,
+                                  const uint64_t timestamp, const SnapshotFilter_t *filter)
+{
+    bool is_first = true;
+
+    buffer_append_str(buf, "{\"generation\":");
+    buffer_append_u64(buf, generation);
+    buffer_append_str(buf, ",\"timestamp\":");
+    buffer_append_u64(buf, timestamp);
+    buffer_append_str(buf, ",\"units\":[");
+
+    for (uint32_t i = 0; i < n_components; i++)
+    {
+        const Component_t *component = &components[i];
+
+        if (!_snapshot_is_selected(component, filter))
+            continue;
+
+        for (uint32_t j = 0; j < component->n_siblings; j++)
+        {
+            const Unit_t *unit = &component->siblings[j];
+            const Counters_t *counters = &component->counters;
+
+            if (!is_first)
+                buffer_append_str(buf, ",");
+            is_first = false;
+
+            buffer_append_str(buf, "{\"name\":\"");
+            buffer_append_json(buf, unit->name);
+            buffer_append_str(buf, "\",\"type\":\"");
+            buffer_append_str(buf, type_str[component->type]);
+            buffer_append_str(buf, "\",\"vendor\":\"");
+            buffer_append_str(buf, vendor_str[component->vendor]);
+            buffer_append_str(buf, "\",\"id\":");
+            buffer_append_u64(buf, unit->id);
+            buffer_append_str(buf, ",\"bus_id\":\"");
+            buffer_append_hex(buf, unit->bus_id);
+            if (unit->serial[0] != '\0')
+            {
+                buffer_append_str(buf, "\",\"serial\":\"");
+                buffer_append_json(buf, unit->serial);
+            }
+            buffer_append_str(buf, "\",\"energy\":");
+            buffer_append_u64(buf, counters->energy_acc[j]);
+            buffer_append_str(buf, ",\"energy_interval\":");
+            buffer_append_u64(buf, counters->energy_interval[j]);
+            buffer_append_str(buf, ",\"timestamp\":");
+            buffer_append_u64(buf, counters->timestamp[j]);
+            buffer_append_str(buf, "}");
+        }
+    }
+
+    buffer_append_str(buf, "]}\n");
+}
+
+/**
+ * Render the snapshot with one key=value pair per line
+ */
+static void _snapshot_render_kv(Buffer_t *buf, const Component_t *components,
+                                const uint32_t n_components, const uint64_t generation,
+                                const uint64_t timestamp, const SnapshotFilter_t *filter)
+{
+    buffer_append_str(buf, "generation=");
+    buffer_append_u64(buf, generation);
+    buffer_append_str(buf, "\ntimestamp=");
+    buffer_append_u64(buf, timestamp);
+    buffer_append_str(buf, "\n");
+
+    for (uint32_t i = 0; i < n_components; i++)
+    {
+        const Component_t *component = &components[i];
+
+        if (!_snapshot_is_selected(component, filter))
+            continue;
+
+        for (uint32_t j = 0; j < component->n_siblings; j++)
+        {
+            const Unit_t *unit = &component->siblings[j];
+            const Counters_t *counters = &component->counters;
+
+            buffer_append_str(buf, unit->name);
+            buffer_append_str(buf, ".energy=");
+            buffer_append_u64(buf, counters->energy_acc[j]);
+            buffer_append_str(buf, "\n");
+            buffer_append_str(buf, unit->name);
+            buffer_append_str(buf, ".energy_interval=");
+            buffer_append_u64(buf, counters->energy_interval[j]);
+            buffer_append_str(buf, "\n");
+            buffer_append_str(buf, unit->name);
+            buffer_append_str(buf, ".timestamp=");
+            buffer_append_u64(buf, counters->timestamp[j]);
+            buffer_append_str(buf, "\n");
+        }
+    }
+}
+
+/**
+ * Render the snapshot in the Prometheus text exposition format
+ */
+static void _snapshot_render_prom(Buffer_t *buf, const Component_t *components,
+                                  const uint32_t n_components, const uint64_t generation,
+                                  const SnapshotFilter_t *filter)
+{
+    buffer_append_str(buf, "# HELP ecounter_energy_joules_total Accumulated energy in joules.\n"
+                           "# TYPE ecounter_energy_joules_total counter\n");
+
+    for (uint32_t i = 0; i < n_components; i++)
+    {
+        const Component_t *component = &components[i];
+
+        if (!_snapshot_is_selected(component, filter))
+            continue;
+
+        for (uint32_t j = 0; j < component->n_siblings; j++)
+        {
+            const Unit_t *unit = &component->siblings[j];
+            const Counters_t *counters = &component->counters;
+
+            buffer_append_str(buf, "ecounter_energy_joules_total{unit=\"");
+            buffer_append_label(buf, unit->name);
+            buffer_append_str(buf, "\",type=\"");
+            buffer_append_str(buf, type_str[component->type]);
+            buffer_append_str(buf, "\",vendor=\"");
+            buffer_append_str(buf, vendor_str[component->vendor]);
+            buffer_append_str(buf, "\",bus_id=\"");
+            buffer_append_hex(buf, unit->bus_id);
+            if (unit->serial[0] != '\0')
+            {
+                buffer_append_str(buf, "\",serial=\"");
+                buffer_append_label(buf, unit->serial);
+            }
+            buffer_append_str(buf, "\"} ");
+            buffer_append_uj(buf, counters->energy_acc_uj[j]);
+            buffer_append_str(buf, "\n");
+        }
+    }
+
+    buffer_append_str(buf, "# HELP ecounter_generation Amount of publications since start.\n"
+                           "# TYPE ecounter_generation counter\n"
+                           "ecounter_generation ");
+    buffer_append_u64(buf, generation);
+    buffer_append_str(buf, "\n");
+}
+
+/**
+ * Render all units of all components in a given format
+ *
+ * @param   buf[inout]       Destination buffer (appended)
+ * @param   format[in]       Snapshot format
+ * @param   components[in]   Array of all components
+ * @param   n_components[in] Amount of components
+ * @param   generation[in]   Generation of the publication
+ * @param   timestamp[in]    Time of the publication (monotonic, ns)
+ * @param   filter[in]       Selection of the components (NULL: all)
+ */
+void snapshot_render(Buffer_t *buf, const int format, const Component_t *components,
+                     const uint32_t n_components, const uint64_t generation,
+                     const uint64_t timestamp, const SnapshotFilter_t *filter)
+{
+    switch (format)
+    {
+        case SNAPSHOT_JSON:
+            _snapshot_render_json(buf, components, n_components, generation, timestamp, filter);
+            break;
+        case SNAPSHOT_KV:
+            _snapshot_render_kv(buf, components, n_components, generation, timestamp, filter);
+            break;
+        case SNAPSHOT_PROM:
+            _snapshot_render_prom(buf, components, n_components, generation, filter);
+            break;
+    }
+}
+
+/**
+ * Enable the snapshot files
+ *
+ * @param   dir_path[in]  Directory where the snapshots are stored
+ * @param   formats[in]   Bitmask of the enabled formats (1 << snapshot_format)
+ * @return  0 on success, a negative error code otherwise
+ */
+int snapshot_init(const char *dir_path, const uint32_t formats)
+{
+    for (int i = 0; i < SNAPSHOT_FORMATS_MAX; i++)
+    {
+        Snapshot_t *snapshot = &_snapshots[i];
+
+        snapshot->is_enabled = (formats & (1U << i)) != 0;
+        if (!snapshot->is_enabled)
+            continue;
+
+        snprintf(snapshot->path, PATH_MAX, "%s/%s", dir_path, _snapshot_file[i]);
+        snprintf(snapshot->tmp_path, PATH_MAX, "%s/.%s.tmp", dir_path, _snapshot_file[i]);
+    }
+
+    return 0;
+}
+
+/**
+ * Remove the snapshot files
+ */
+void snapshot_fini(void)
+{
+    for (int i = 0; i < SNAPSHOT_FORMATS_MAX; i++)
+    {
+        Snapshot_t *snapshot = &_snapshots[i];
+
+        if (!snapshot->is_enabled)
+            continue;
+
+        unlink(snapshot->path);
+        snapshot->is_enabled = false;
+    }
+
+    buffer_free(&_snapshot_buf);
+}
+
+/**
+ * Write all enabled snapshots, each one in a temporary file renamed over
+ * the previous snapshot
+ *
+ * @param   components[in]   Array of all components
+ * @param   n_components[in] Amount of components
+ * @param   generation[in]   Generation of the publication
+ */
+void snapshot_publish(const Component_t *components, const uint32_t n_components,
+                      const uint64_t generation)
+{
+    const uint64_t timestamp = get_time_ns();
+
+    for (int i = 0; i < SNAPSHOT_FORMATS_MAX; i++)
+    {
+        Snapshot_t *snapshot = &_snapshots[i];
+
+        if (!snapshot->is_enabled)
+            continue;
+
+        buffer_reset(&_snapshot_buf);
+        snapshot_render(&_snapshot_buf, i, components, n_components, generation, timestamp, NULL);
+
+        int fd = open(snapshot->tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0)
+        {
+            fprintf(stderr, "Failed to open snapshot file %s: %s\n", snapshot->tmp_path, strerror(errno));
+            continue;
+        }
+
+        const ssize_t ret = write(fd, _snapshot_buf.data, _snapshot_buf.len);
+        close(fd);
+
+        if (ret != (ssize_t)_snapshot_buf.len)
+        {
+            fprintf(stderr, "Failed to write snapshot file %s\n", snapshot->tmp_path);
+            unlink(snapshot->tmp_path);
+            continue;
+        }
+
+        if (rename(snapshot->tmp_path, snapshot->path) != 0)
+            fprintf(stderr, "Failed to rename snapshot file %s: %s\n", snapshot->path, strerror(errno));
+    }
+}
@@ -0,0 +1,64 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* EnergyCounter: Fetch and expose energy counters.
+* snapshot.h: Consolidated snapshot of all energy counters.
+*
+* URL       https://github.com/HewlettPackard/EnergyCounter
+******************************************************************************/
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include "buffer.h"
+#include "interface.h"
+
+enum snapshot_format {
+    SNAPSHOT_JSON,
+    SNAPSHOT_KV,
+    SNAPSHOT_PROM,
+    SNAPSHOT_FORMATS_MAX
+};
+
+static const char * const snapshot_format_str[] =
+{
+    [SNAPSHOT_JSON] = "json",
+    [SNAPSHOT_KV]   = "kv",
+    [SNAPSHOT_PROM] = "prom",
+};
+
+/* Selection of the rendered components */
+typedef struct SnapshotFilter
+{
+    int       type;                 /* Only components of this type (TYPE_UNKNOWN: all) */
+    uint64_t  since;                /* Only components published after this generation */
+} SnapshotFilter_t;
+
+void snapshot_render(Buffer_t *buf, const int format, const Component_t *components,
+                     const uint32_t n_components, const uint64_t generation,
+                     const uint64_t timestamp, const SnapshotFilter_t *filter);
+int snapshot_init(const char *dir_path, const uint32_t formats);
+void snapshot_fini(void);
+void snapshot_publish(const Component_t *components, const uint32_t n_components,
+                      const uint64_t generation);
+
+#endif /* SNAPSHOT_H */
@@ -0,0 +1,494 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* EnergyCounter: Fetch and expose energy counters.
+* topology.c: CPU topology shared by the modules. The online CPUs and the
+*             CPU lists of each package and die are parsed once, instead of
+*             probing every CPU, and parsed again on CPU hotplug events.
+*             Each package and die is read by its first online CPU.
+*
+* URL       https://github.com/HewlettPackard/EnergyCounter
+******************************************************************************/
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/limits.h>
+#include <linux/netlink.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include "interface.h"
+#include "common.h"
+#include "topology.h"
+
+#define TOPOLOGY_PATH       "/sys/devices/system/cpu"
+#define TOPOLOGY_UEVENT_MAX 4096
+
+#define TOPOLOGY_UNKNOWN    UINT32_MAX
+
+typedef struct TopologyCpu
+{
+    bool          is_online;
+    uint32_t      package;                  /* Package id                 */
+    uint32_t      die;                      /* Index of the die           */
+} TopologyCpu_t;
+
+typedef struct TopologyDie
+{
+    uint32_t      package;
+    uint32_t      die_id;                   /* Id within the package      */
+    uint32_t      reader;                   /* First online CPU           */
+} TopologyDie_t;
+
+static TopologyCpu_t *_topology_cpus = NULL;          /* Indexed by CPU id          */
+static uint32_t       _topology_n_cpus = 0;           /* Possible CPUs              */
+static uint32_t      *_topology_package_readers = NULL;
+static uint32_t       _topology_n_packages = 0;
+static TopologyDie_t *_topology_dies = NULL;
+static uint32_t       _topology_n_dies = 0;
+
+static Scheduler_t   *_topology_sched = NULL;
+static Watch_t        _topology_uevents = { .fd = -1 };
+static void         (*_topology_on_change)(void *) = NULL;
+static void          *_topology_on_change_arg = NULL;
+
+/**
+ * Parse a CPU list such as "0-3,8,10-11"
+ *
+ * @param   path[in]    Path of the file
+ * @param   cpus[out]   CPUs of the list are set (NULL to only count them)
+ * @param   n_cpus[in]  Size of the cpus array
+ * @param   end[out]    Highest CPU of the list plus one
+ * @return  0 on success, a negative error code otherwise
+ */
+static int _topology_read_list(const char *path, bool *cpus, const uint32_t n_cpus, uint32_t *end)
+{
+    char *line = NULL;
+    size_t len = 0;
+
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+        return -errno;
+
+    int ret = (getline(&line, &len, fp) > 0) ? 0 : -EIO;
+    fclose(fp);
+
+    *end = 0;
+    for (char *range = line; ret == 0 && *range != '\0' && *range != '\n';)
+    {
+        char *sep;
+        const uint32_t first = strtoul(range, &sep, 10);
+        uint32_t last = first;
+
+        if (sep == range)
+        {
+            ret = -EINVAL;
+            break;
+        }
+        if (*sep == '-')
+            last = strtoul(sep + 1, &sep, 10);
+
+        for (uint32_t cpu = first; cpus != NULL && cpu <= last && cpu < n_cpus; cpu++)
+            cpus[cpu] = true;
+        *end = MAX(*end, last + 1);
+
+        range = (*sep == ',') ? sep + 1 : sep;
+    }
+
+    free(line);
+
+    return ret;
+}
+
+/**
+ * Read the first integer of a file of the topology of a CPU
+ *
+ * @param   cpu[in]     Id of the hardware thread
+ * @param   file[in]    Path relative to the directory of the CPU
+ * @param   value[out]  Value read
+ * @return  0 on success, a negative error code otherwise
+ */
+static int _topology_read_cpu(const uint32_t cpu, const char *file, uint32_t *value)
+{
+    char path[PATH_MAX];
+    snprintf(path, PATH_MAX, TOPOLOGY_PATH "/cpu%u/%s", cpu, file);
+
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+        return -errno;
+
+    const int ret = (fscanf(fp, "%u", value) == 1) ? 0 : -EINVAL;
+    fclose(fp);
+
+    return ret;
+}
+
+/**
+ * Read a CPU list of the topology of a CPU, with a fallback for older kernels
+ *
+ * @param   cpu[in]       Id of the hardware thread
+ * @param   file[in]      Path relative to the directory of the CPU
+ * @param   fallback[in]  Path used if the first one does not exist
+ * @param   cpus[out]     CPUs of the list are set
+ * @return  0 on success, a negative error code otherwise
+ */
+static int _topology_read_cpu_list(const uint32_t cpu, const char *file, const char *fallback, bool *cpus)
+{
+    char path[PATH_MAX];
+    uint32_t end;
+
+    memset(cpus, 0, _topology_n_cpus * sizeof(bool));
+
+    snprintf(path, PATH_MAX, TOPOLOGY_PATH "/cpu%u/%s", cpu, file);
+    int ret = _topology_read_list(path, cpus, _topology_n_cpus, &end);
+    if (ret == -ENOENT && fallback != NULL)
+    {
+        snprintf(path, PATH_MAX, TOPOLOGY_PATH "/cpu%u/%s", cpu, fallback);
+        ret = _topology_read_list(path, cpus, _topology_n_cpus, &end);
+    }
+
+    return ret;
+}
+
+/**
+ * Parse the online CPUs and the package and die of each of them. Only the
+ * first online CPU of each package and die is probed.
+ *
+ * @return  0 on success, a negative error code otherwise
+ */
+static int _topology_scan(void)
+{
+    bool *online = calloc(_topology_n_cpus, sizeof(bool));
+    bool *siblings = calloc(_topology_n_cpus, sizeof(bool));
+    uint32_t end;
+    int ret = -ENOMEM;
+
+    if (online == NULL || siblings == NULL)
+        goto out;
+
+    ret = _topology_read_list(TOPOLOGY_PATH "/online", online, _topology_n_cpus, &end);
+    if (ret != 0)
+        goto out;
+
+    for (uint32_t cpu = 0; cpu < _topology_n_cpus; cpu++)
+        _topology_cpus[cpu] = (TopologyCpu_t) {
+            .is_online = online[cpu],
+            .package   = TOPOLOGY_UNKNOWN,
+            .die       = TOPOLOGY_UNKNOWN,
+        };
+    _topology_n_packages = 0;
+    _topology_n_dies = 0;
+
+    for (uint32_t cpu = 0; cpu < _topology_n_cpus; cpu++)
+    {
+        uint32_t package, die_id;
+
+        if (!online[cpu] || _topology_cpus[cpu].die != TOPOLOGY_UNKNOWN)
+            continue;
+
+        /* A CPU going offline during the scan has no topology anymore */
+        if (_topology_read_cpu(cpu, "topology/physical_package_id", &package) != 0)
+        {
+            _topology_cpus[cpu].is_online = false;
+            continue;
+        }
+
+        if (_topology_cpus[cpu].package == TOPOLOGY_UNKNOWN)
+        {
+            if (_topology_read_cpu_list(cpu, "topology/package_cpus_list", "topology/core_siblings_list",
+                                        siblings) != 0)
+                siblings[cpu] = true;
+
+            for (uint32_t sibling = 0; sibling < _topology_n_cpus; sibling++)
+                if (siblings[sibling] && online[sibling])
+                    _topology_cpus[sibling].package = package;
+            _topology_n_packages = MAX(_topology_n_packages, package + 1);
+        }
+
+        /* Kernels without dies have one die per package */
+        if (_topology_read_cpu(cpu, "topology/die_id", &die_id) != 0)
+            die_id = 0;
+        if (_topology_read_cpu_list(cpu, "topology/die_cpus_list", "topology/package_cpus_list", siblings) != 0)
+            siblings[cpu] = true;
+
+        TopologyDie_t *dies = realloc(_topology_dies, (_topology_n_dies + 1) * sizeof(TopologyDie_t));
+        if (dies == NULL)
+        {
+            ret = -ENOMEM;
+            goto out;
+        }
+        _topology_dies = dies;
+        _topology_dies[_topology_n_dies] = (TopologyDie_t) { .package = package, .die_id = die_id, .reader = cpu };
+
+        for (uint32_t sibling = 0; sibling < _topology_n_cpus; sibling++)
+            if (siblings[sibling] && online[sibling] && _topology_cpus[sibling].package == package)
+                _topology_cpus[sibling].die = _topology_n_dies;
+        _topology_cpus[cpu].die = _topology_n_dies++;
+    }
+
+    uint32_t *readers = realloc(_topology_package_readers, MAX(_topology_n_packages, 1) * sizeof(uint32_t));
+    if (readers == NULL)
+    {
+        ret = -ENOMEM;
+        goto out;
+    }
+    _topology_package_readers = readers;
+
+    /* CPUs are scanned in order, the reader of a die is its first CPU */
+    for (uint32_t i = 0; i < _topology_n_packages; i++)
+        _topology_package_readers[i] = TOPOLOGY_NO_CPU;
+    for (uint32_t i = _topology_n_dies; i > 0; i--)
+        _topology_package_readers[_topology_dies[i - 1].package] = _topology_dies[i - 1].reader;
+
+out:
+    free(online);
+    free(siblings);
+
+    return ret;
+}
+
+/**
+ * Parse the hotplug events of the kernel and scan the topology again when
+ * a CPU goes online or offline
+ *
+ * @param   arg[in]     Unused
+ * @param   events[in]  Epoll events
+ */
+static void _topology_uevent(void *arg, const uint32_t events)
+{
+    char buf[TOPOLOGY_UEVENT_MAX];
+    bool is_changed = false;
+    ssize_t len;
+
+    (void)arg;
+    (void)events;
+
+    /* Messages start with "<action>@<devpath>" */
+    while ((len = recv(_topology_uevents.fd, buf, sizeof(buf) - 1, MSG_DONTWAIT)) > 0)
+    {
+        buf[len] = '\0';
+
+        const char *devpath = strchr(buf, '@');
+        if (devpath != NULL && strncmp(devpath + 1, "/devices/system/cpu/cpu", 23) == 0 &&
+            (strncmp(buf, "online@", 7) == 0 || strncmp(buf, "offline@", 8) == 0 ||
+             strncmp(buf, "add@", 4) == 0 || strncmp(buf, "remove@", 7) == 0))
+            is_changed = true;
+    }
+
+    if (!is_changed)
+        return;
+
+    int ret = _topology_scan();
+    if (ret != 0)
+    {
+        fprintf(stderr, "Unable to scan the CPU topology: %s\n", strerror(-ret));
+        return;
+    }
+
+    if (_topology_on_change != NULL)
+        _topology_on_change(_topology_on_change_arg);
+}
+
+/**
+ * Parse the CPU topology
+ *
+ * @return  0 on success, a negative error code otherwise
+ */
+int topology_init(void)
+{
+    uint32_t n_cpus;
+
+    int ret = _topology_read_list(TOPOLOGY_PATH "/possible", NULL, 0, &n_cpus);
+    if (ret != 0)
+        ret = _topology_read_list(TOPOLOGY_PATH "/online", NULL, 0, &n_cpus);
+    if (ret != 0)
+        return ret;
+
+    _topology_cpus = calloc(MAX(n_cpus, 1), sizeof(TopologyCpu_t));
+    if (_topology_cpus == NULL)
+        return -ENOMEM;
+    _topology_n_cpus = n_cpus;
+
+    return _topology_scan();
+}
+
+/**
+ * Stop watching the hotplug events and release the topology
+ */
+void topology_fini(void)
+{
+    if (_topology_uevents.fd >= 0)
+    {
+        sched_unwatch(_topology_sched, &_topology_uevents);
+        close(_topology_uevents.fd);
+        _topology_uevents.fd = -1;
+    }
+
+    free(_topology_cpus);
+    free(_topology_package_readers);
+    free(_topology_dies);
+    _topology_cpus = NULL;
+    _topology_package_readers = NULL;
+    _topology_dies = NULL;
+    _topology_n_cpus = 0;
+    _topology_n_packages = 0;
+    _topology_n_dies = 0;
+}
+
+/**
+ * Listen to the CPU hotplug events of the kernel (netlink uevents)
+ *
+ * @param   sched[inout]    Scheduler running the event loop
+ * @param   on_change[in]   Called once the topology changed
+ * @param   arg[in]         Argument of on_change
+ * @return  0 on success, a negative error code otherwise
+ */
+int topology_watch(Scheduler_t *sched, void (*on_change)(void *), void *arg)
+{
+    struct sockaddr_nl addr = { .nl_family = AF_NETLINK, .nl_groups = 1 };
+
+    _topology_uevents.fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                                  NETLINK_KOBJECT_UEVENT);
+    if (_topology_uevents.fd < 0)
+        return -errno;
+
+    int ret = (bind(_topology_uevents.fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) ? 0 : -errno;
+
+    _topology_uevents.handle = _topology_uevent;
+    if (ret == 0)
+        ret = sched_watch(sched, &_topology_uevents, EPOLLIN);
+
+    if (ret != 0)
+    {
+        close(_topology_uevents.fd);
+        _topology_uevents.fd = -1;
+        return ret;
+    }
+
+    _topology_sched = sched;
+    _topology_on_change = on_change;
+    _topology_on_change_arg = arg;
+
+    return 0;
+}
+
+/**
+ * Return the amount of possible CPUs, online or not
+ */
+uint32_t topology_n_cpus(void)
+{
+    return _topology_n_cpus;
+}
+
+/**
+ * Check whether a CPU is online
+ *
+ * @param   cpu[in]     Id of the hardware thread
+ */
+bool topology_is_online(const uint32_t cpu)
+{
+    return cpu < _topology_n_cpus && _topology_cpus[cpu].is_online;
+}
+
+/**
+ * Return the package of an online CPU
+ *
+ * @param   cpu[in]       Id of the hardware thread
+ * @param   package[out]  Package id
+ * @return  0 on success, -ENODEV if the CPU is not online
+ */
+int topology_package(const uint32_t cpu, uint32_t *package)
+{
+    if (!topology_is_online(cpu) || _topology_cpus[cpu].package == TOPOLOGY_UNKNOWN)
+        return -ENODEV;
+
+    *package = _topology_cpus[cpu].package;
+
+    return 0;
+}
+
+/**
+ * Return the die of an online CPU
+ *
+ * @param   cpu[in]     Id of the hardware thread
+ * @param   die[out]    Index of the die, see topology_n_dies()
+ * @return  0 on success, -ENODEV if the CPU is not online
+ */
+int topology_die(const uint32_t cpu, uint32_t *die)
+{
+    if (!topology_is_online(cpu) || _topology_cpus[cpu].die == TOPOLOGY_UNKNOWN)
+        return -ENODEV;
+
+    *die = _topology_cpus[cpu].die;
+
+    return 0;
+}
+
+/**
+ * Return the amount of packages, ids go from 0 to this amount excluded
+ */
+uint32_t topology_n_packages(void)
+{
+    return _topology_n_packages;
+}
+
+/**
+ * Return the CPU reading the counters of a package
+ *
+ * @param   package[in] Package id
+ * @return  First online CPU of the package, TOPOLOGY_NO_CPU if none
+ */
+uint32_t topology_package_reader(const uint32_t package)
+{
+    return (package < _topology_n_packages) ? _topology_package_readers[package] : TOPOLOGY_NO_CPU;
+}
+
+/**
+ * Return the amount of dies with an online CPU, over all packages
+ */
+uint32_t topology_n_dies(void)
+{
+    return _topology_n_dies;
+}
+
+/**
+ * Return the package of a die
+ *
+ * @param   die[in]     Index of the die
+ */
+uint32_t topology_die_package(const uint32_t die)
+{
+    return _topology_dies[die].package;
+}
+
+/**
+ * Return the CPU reading the counters of a die
+ *
+ * @param   die[in]     Index of the die
+ * @return  First online CPU of the die
+ */
+uint32_t topology_die_reader(const uint32_t die)
+{
+    return _topology_dies[die].reader;
+}
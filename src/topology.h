@@ -0,0 +1,51 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* EnergyCounter: Fetch and expose energy counters.
+* topology.h: CPU topology shared by the modules: online CPUs, their package
+*             and die, and the CPU reading each package or die.
+*
+* URL       https://github.com/HewlettPackard/EnergyCounter
+******************************************************************************/
+
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "scheduler.h"
+
+#define TOPOLOGY_NO_CPU UINT32_MAX   /* Package or die without any online CPU */
+
+int topology_init(void);
+void topology_fini(void);
+int topology_watch(Scheduler_t *sched, void (*on_change)(void *), void *arg);
+uint32_t topology_n_cpus(void);
+bool topology_is_online(const uint32_t cpu);
+int topology_package(const uint32_t cpu, uint32_t *package);
+int topology_die(const uint32_t cpu, uint32_t *die);
+uint32_t topology_n_packages(void);
+uint32_t topology_package_reader(const uint32_t package);
+uint32_t topology_n_dies(void);
+uint32_t topology_die_package(const uint32_t die);
+uint32_t topology_die_reader(const uint32_t die);
+
+#endif /* TOPOLOGY_H */
@@ -0,0 +1,229 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* EnergyCounter: Fetch and expose energy counters.
+* worker.c: Workers collecting the components in parallel, one per backend.
+*            Components due in a same scheduler round start together and the
+*            round is published once all of them are collected, so the latency
+*            of a round is the one of the slowest backend.
+*
+* URL       https://github.com/HewlettPackard/EnergyCounter
+******************************************************************************/
+
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "interface.h"
+#include "common.h"
+#include "worker.h"
+
+/* Components queued on a worker, the queue holds every component at most */
+typedef struct Worker
+{
+    pthread_t        thread;
+    pthread_mutex_t  lock;
+    sem_t            start;                         /* Posted once per component  */
+    Component_t     *queue[INTERFACES_MAX];
+    uint32_t         head;
+    uint32_t         n_queued;
+    bool             is_started;
+} Worker_t;
+
+static Worker_t     _workers[INTERFACES_MAX];
+static Component_t *_workers_components = NULL;    /* Indexed like the workers   */
+static uint32_t     _workers_n_started = 0;
+static sem_t        _workers_done;                  /* Posted once per collection */
+static uint32_t     _workers_n_pending = 0;         /* Collections not waited for */
+
+/**
+ * Return the worker of a component. CPU and DRAM share the RAPL sampler,
+ * hence the same worker.
+ *
+ * @param   i[in]   Index of the component (see interface.h)
+ */
+static inline uint32_t _worker_of(const uint32_t i)
+{
+    return (i == DRAMS) ? CPUS : i;
+}
+
+/**
+ * Collect the components queued on a worker, until a NULL one is queued
+ *
+ * @param   arg[in]   Worker structure
+ */
+static void *_worker_run(void *arg)
+{
+    Worker_t *worker = (Worker_t *)arg;
+
+    while (true)
+    {
+        while (sem_wait(&worker->start) != 0)
+            ;
+
+        pthread_mutex_lock(&worker->lock);
+        Component_t *component = worker->queue[worker->head];
+        worker->head = (worker->head + 1) % INTERFACES_MAX;
+        worker->n_queued--;
+        pthread_mutex_unlock(&worker->lock);
+
+        if (component == NULL)
+            break;
+
+        component->update(component);
+        sem_post(&_workers_done);
+    }
+
+    return NULL;
+}
+
+/**
+ * Queue a component on its worker
+ *
+ * @param   worker[inout]   Worker structure
+ * @param   component[in]   Component to collect, NULL to stop the worker
+ */
+static void _worker_queue(Worker_t *worker, Component_t *component)
+{
+    pthread_mutex_lock(&worker->lock);
+    worker->queue[(worker->head + worker->n_queued) % INTERFACES_MAX] = component;
+    worker->n_queued++;
+    pthread_mutex_unlock(&worker->lock);
+
+    sem_post(&worker->start);
+}
+
+/**
+ * Start one worker per backend with units. With a single backend, the
+ * components are collected by the caller.
+ *
+ * @param   components[in]   Array of all components
+ * @param   n_components[in] Amount of components
+ * @return  0 on success, a negative error code otherwise
+ */
+int workers_init(Component_t *components, const uint32_t n_components)
+{
+    bool is_used[INTERFACES_MAX] = { false };
+    uint32_t n_workers = 0;
+
+    for (uint32_t i = 0; i < MIN(n_components, INTERFACES_MAX); i++)
+        if (components[i].n_siblings > 0 && !is_used[_worker_of(i)])
+        {
+            is_used[_worker_of(i)] = true;
+            n_workers++;
+        }
+
+    if (n_workers < 2)
+        return 0;
+
+    _workers_components = components;
+    sem_init(&_workers_done, 0, 0);
+
+    /* Signals are handled by the main thread only */
+    sigset_t signals, previous;
+    sigfillset(&signals);
+    pthread_sigmask(SIG_BLOCK, &signals, &previous);
+
+    int ret = 0;
+    for (uint32_t i = 0; i < INTERFACES_MAX && ret == 0; i++)
+    {
+        Worker_t *worker = &_workers[i];
+
+        if (!is_used[i])
+            continue;
+
+        pthread_mutex_init(&worker->lock, NULL);
+        sem_init(&worker->start, 0, 0);
+        worker->head = 0;
+        worker->n_queued = 0;
+
+        ret = -pthread_create(&worker->thread, NULL, _worker_run, worker);
+        if (ret == 0)
+        {
+            worker->is_started = true;
+            _workers_n_started++;
+        }
+    }
+
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+    return ret;
+}
+
+/**
+ * Stop the workers once their pending collections are done
+ */
+void workers_fini(void)
+{
+    if (_workers_n_started == 0)
+        return;
+
+    /* Queues are processed in order, the worker stops last */
+    for (uint32_t i = 0; i < INTERFACES_MAX; i++)
+    {
+        Worker_t *worker = &_workers[i];
+
+        if (!worker->is_started)
+            continue;
+
+        _worker_queue(worker, NULL);
+        pthread_join(worker->thread, NULL);
+        sem_destroy(&worker->start);
+        pthread_mutex_destroy(&worker->lock);
+        worker->is_started = false;
+    }
+
+    sem_destroy(&_workers_done);
+    _workers_n_started = 0;
+    _workers_n_pending = 0;
+}
+
+/**
+ * Start the collection of a component on its worker, or collect it now
+ * without workers
+ *
+ * @param   component[inout]  Component to collect, its tick must be set
+ */
+void workers_post(Component_t *component)
+{
+    if (_workers_n_started == 0)
+    {
+        component->update(component);
+        return;
+    }
+
+    _workers_n_pending++;
+    _worker_queue(&_workers[_worker_of(component - _workers_components)], component);
+}
+
+/**
+ * Wait until all the collections started are done
+ */
+void workers_wait(void)
+{
+    for (; _workers_n_pending > 0; _workers_n_pending--)
+        while (sem_wait(&_workers_done) != 0)
+            ;
+}
@@ -0,0 +1,183 @@
+/**
+* (C) Copyright 2025 Hewlett Packard Enterprise Development LP
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+* OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+******************************************************************************
+* EnergyCounter: Fetch and expose energy counters.
+* ecounter-dump.c: Decode the segments of a journal written with --journal.
+*                  Segments are read block by block with bounded memory.
+*
+* URL       https://github.com/HewlettPackard/EnergyCounter
+******************************************************************************/
+
+#include <argp.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "journal.h"
+
+#define VERSION  "0.1"
+#define CONTACT  "https://github.com/HewlettPackard/EnergyCounter"
+
+#define JOURNAL_UNITS_MAX 4096
+
+typedef struct Dump
+{
+    bool      is_realtime;          /* Print wall clock timestamps           */
+    char    **segments;             /* Paths of the segments                 */
+    int       n_segments;
+} Dump_t;
+
+const char *argp_program_version = VERSION;
+const char *argp_program_bug_address = CONTACT;
+
+static char doc[] = "Decode the segments of an ecounter journal and print one line per "
+                    "sample: timestamp (ns), unit, raw value of the counter and energy "
+                    "of the interval (uJ).";
+
+static char args_doc[] = "<segment>...";
+
+static struct argp_option options[] =
+{
+    {"realtime", 'r', 0, 0, "Print the timestamps with the realtime clock instead of the "
+                            "monotonic one"},
+    {0}
+};
+
+static JournalUnit_t  _units[JOURNAL_UNITS_MAX];
+static JournalState_t _states[JOURNAL_UNITS_MAX];
+static uint8_t        _payload[JOURNAL_BLOCK_MAX];
+
+/**
+ * Decode all blocks of a segment
+ *
+ * @param   path[in]   Path of the segment
+ * @param   dump[in]   Options
+ * @return  0 on success, -1 otherwise
+ */
+static int dump_segment(const char *path, const Dump_t *dump)
+{
+    JournalHeader_t header;
+    JournalBlock_t block;
+    int ret = -1;
+
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Unable to open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    if (fread(&header, sizeof(header), 1, fp) != 1 || header.magic != JOURNAL_MAGIC ||
+        header.version < 1 || header.version > JOURNAL_VERSION || header.unit_size != sizeof(JournalUnit_t) ||
+        header.n_units > JOURNAL_UNITS_MAX ||
+        fread(_units, sizeof(JournalUnit_t), header.n_units, fp) != header.n_units)
+    {
+        fprintf(stderr, "%s is not a valid journal segment\n", path);
+        goto exit;
+    }
+
+    for (uint32_t i = 0; i < header.n_units; i++)
+        _units[i].name[sizeof(_units[i].name) - 1] = '\0';
+
+    const int64_t offset = dump->is_realtime ? (int64_t)(header.realtime - header.monotonic) : 0;
+    const uint64_t energy_scale = (header.version == 1) ? 1000000 : 1;   /* Joules in version 1 */
+
+    while (fread(&block, sizeof(block), 1, fp) == 1)
+    {
+        if (block.magic != JOURNAL_BLOCK_MAGIC || block.len > JOURNAL_BLOCK_MAX ||
+            fread(_payload, 1, block.len, fp) != block.len)
+        {
+            fprintf(stderr, "%s: truncated block, stopping\n", path);
+            goto exit;
+        }
+
+        memset(_states, 0, header.n_units * sizeof(JournalState_t));
+
+        uint32_t pos = 0;
+        for (uint32_t i = 0; i < block.n_records; i++)
+        {
+            uint32_t unit;
+            uint64_t timestamp, energy_raw, energy;
+            const uint32_t n = journal_decode(&_payload[pos], block.len - pos, _states,
+                                              header.n_units, &unit, &timestamp,
+                                              &energy_raw, &energy);
+            if (n == 0)
+            {
+                fprintf(stderr, "%s: corrupted block, stopping\n", path);
+                goto exit;
+            }
+            pos += n;
+
+            printf("%lu %s %lu %lu\n", timestamp + offset, _units[unit].name, energy_raw,
+                   energy * energy_scale);
+        }
+    }
+
+    ret = 0;
+
+exit:
+    fclose(fp);
+    return ret;
+}
+
+/**
+ * Parse the options
+ */
+static error_t parse_opt(int key, char *arg, struct argp_state *state)
+{
+    Dump_t *dump = state->input;
+
+    switch (key)
+    {
+        case 'r':
+            dump->is_realtime = true;
+            break;
+        case ARGP_KEY_ARGS:
+            dump->segments = &state->argv[state->next];
+            dump->n_segments = state->argc - state->next;
+            break;
+        case ARGP_KEY_NO_ARGS:
+            argp_usage(state);
+            break;
+        default:
+            return ARGP_ERR_UNKNOWN;
+    }
+
+    return 0;
+}
+
+static struct argp argp = { options, parse_opt, args_doc, doc };
+
+int main(int argc, char *argv[])
+{
+    Dump_t dump = { 0 };
+    int ret = EXIT_SUCCESS;
+
+    argp_parse(&argp, argc, argv, 0, 0, &dump);
+
+    for (int i = 0; i < dump.n_segments; i++)
+        if (dump_segment(dump.segments[i], &dump) != 0)
+            ret = EXIT_FAILURE;
+
+    return ret;
+}